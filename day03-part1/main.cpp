@@ -1,8 +1,19 @@
+#include <array>
+#include <bit>
 #include <chrono>
+#include <cmath>
+#include <cstdint>
 #include <filesystem>
 #include <fstream>
+#include <istream>
+#include <optional>
 #include <sstream>
-#include <cmath>
+#include <string>
+#include <string_view>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
 
 static std::string read_data(const std::filesystem::path& path)
 {
@@ -17,13 +28,20 @@ static bool is_digit(const char c)
     return c >= '0' && c <= '9';
 }
 
+// Mul operands are 1 to 3 digit numbers, which also keeps every product well inside an int
+constexpr int max_operand_digits = 3;
+
 static std::optional<int> parse_int_opt(const std::string& string, int& pos)
 {
     if (!is_digit(string[pos])) {
         return std::nullopt;
     }
     int result = 0;
+    int n_digits = 0;
     do {
+        if (++n_digits > max_operand_digits) {
+            return std::nullopt;
+        }
         result = result * 10 + (string[pos] - '0');
         ++pos;
     } while (is_digit(string[pos]) && pos < string.length());
@@ -57,10 +75,48 @@ static std::optional<int> parse_mul(const std::string& string, int& pos)
     return value1.value() * value2.value();
 }
 
-static int solve(const std::string& data)
+// Bit i is set if ptr[i] == c, for i in [0, 32)
+static uint32_t byte_mask_32(const char* ptr, const char c)
+{
+#if defined(__AVX2__)
+    const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr));
+    return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, _mm256_set1_epi8(c))));
+#elif defined(__SSE2__) || defined(_M_X64)
+    const __m128i needle = _mm_set1_epi8(c);
+    const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr));
+    const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr + 16));
+    return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(low, needle)))
+        | static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(high, needle))) << 16;
+#else
+    uint32_t mask = 0;
+    for (int i = 0; i < 32; ++i) {
+        mask |= static_cast<uint32_t>(ptr[i] == c) << i;
+    }
+    return mask;
+#endif
+}
+
+// Positions in [ptr, ptr + 32) that start with "mul(", reads up to ptr + 35
+static uint32_t mul_candidates(const char* ptr)
 {
-    int total = 0;
-    for (int pos = 0; pos < data.length();) {
+    return byte_mask_32(ptr, 'm') & byte_mask_32(ptr + 1, 'u') & byte_mask_32(ptr + 2, 'l')
+        & byte_mask_32(ptr + 3, '(');
+}
+
+static int64_t solve(const std::string& data)
+{
+    int64_t total = 0;
+    int pos = 0;
+    // Only the candidates found 32 bytes at a time are handed to the full parser
+    for (; pos + 35 < data.length(); pos += 32) {
+        for (uint32_t mask = mul_candidates(data.data() + pos); mask != 0; mask &= mask - 1) {
+            int mul_pos = pos + std::countr_zero(mask);
+            if (const std::optional<int> result = parse_mul(data, mul_pos); result.has_value()) {
+                total += result.value();
+            }
+        }
+    }
+    while (pos < data.length()) {
         if (const std::optional<int> result = parse_mul(data, pos); result.has_value()) {
             total += result.value();
         }
@@ -68,9 +124,131 @@ static int solve(const std::string& data)
     return total;
 }
 
+#ifdef BENCHMARK
+// Resumable parser that takes the input in blocks of any size, a mul may be split across blocks
+class StreamParser {
+public:
+    void feed(const std::string_view block)
+    {
+        size_t pos = 0;
+        while (pos < block.length()) {
+            if (m_state == State::idle) {
+                pos = next_token_start(block, pos);
+                if (pos == block.length()) {
+                    break;
+                }
+            }
+            step(block[pos]);
+            ++pos;
+        }
+    }
+
+    [[nodiscard]] int64_t total() const
+    {
+        return m_total;
+    }
+
+private:
+    enum class State { idle, literal, first_operand, second_operand };
+
+    static constexpr std::string_view mul_key = "mul(";
+
+    static size_t next_token_start(const std::string_view block, size_t pos)
+    {
+        for (; pos + 35 < block.length(); pos += 32) {
+            if (const uint32_t mask = mul_candidates(block.data() + pos); mask != 0) {
+                return pos + std::countr_zero(mask);
+            }
+        }
+        while (pos < block.length() && block[pos] != 'm') {
+            ++pos;
+        }
+        return pos;
+    }
+
+    void step(const char c)
+    {
+        switch (m_state) {
+        case State::idle:
+            break;
+        case State::literal:
+            if (c == mul_key[m_literal_pos]) {
+                if (++m_literal_pos == mul_key.length()) {
+                    finish_literal();
+                }
+                return;
+            }
+            break;
+        case State::first_operand:
+            if (is_digit(c) && m_n_digits < max_operand_digits) {
+                m_first = m_first * 10 + (c - '0');
+                ++m_n_digits;
+                return;
+            }
+            if (c == ',' && m_n_digits > 0) {
+                m_state = State::second_operand;
+                m_n_digits = 0;
+                return;
+            }
+            break;
+        case State::second_operand:
+            if (is_digit(c) && m_n_digits < max_operand_digits) {
+                m_second = m_second * 10 + (c - '0');
+                ++m_n_digits;
+                return;
+            }
+            if (c == ')' && m_n_digits > 0) {
+                m_total += m_first * m_second;
+                m_state = State::idle;
+                return;
+            }
+            break;
+        }
+        // The mul does not continue with c, but c may start a new one
+        start_token(c);
+    }
+
+    void start_token(const char c)
+    {
+        m_state = c == 'm' ? State::literal : State::idle;
+        m_literal_pos = 1;
+    }
+
+    void finish_literal()
+    {
+        m_state = State::first_operand;
+        m_first = 0;
+        m_second = 0;
+        m_n_digits = 0;
+    }
+
+    State m_state = State::idle;
+    size_t m_literal_pos = 0;
+    int64_t m_first = 0;
+    int64_t m_second = 0;
+    int m_n_digits = 0;
+    int64_t m_total = 0;
+};
+
+constexpr size_t stream_buffer_size = 64 * 1024;
+
+// Memory use is bounded by the buffer size regardless of input size
+static int64_t solve_stream(std::istream& stream)
+{
+    StreamParser parser;
+    std::array<char, stream_buffer_size> buffer;
+    while (stream) {
+        stream.read(buffer.data(), buffer.size());
+        parser.feed({ buffer.data(), static_cast<size_t>(stream.gcount()) });
+    }
+    return parser.total();
+}
+#endif
+
 int main()
 {
-    const std::string data = read_data("./day03-part1/input.txt");
+    const std::filesystem::path path = "./day03-part1/input.txt";
+    const std::string data = read_data(path);
 
 #ifdef BENCHMARK
     constexpr int n_runs = 100000;
@@ -81,12 +259,39 @@ int main()
         // ReSharper disable once CppDFAUnusedValue
         // ReSharper disable once CppDFAUnreadVariable
         // ReSharper disable once CppDeclaratorNeverUsed
-        volatile int result = solve(data);
+        volatile int64_t result = solve(data);
         auto end = std::chrono::high_resolution_clock::now();
         time_running_total += std::chrono::duration<double, std::nano>(end - start).count();
     }
     std::printf("Average ns: %d\n", static_cast<int>(std::round(time_running_total / n_runs)));
+
+    // Reading the whole file compared to streaming it, both including I/O
+    constexpr int n_io_runs = 10000;
+    double time_whole_total = 0.0;
+    double time_stream_total = 0.0;
+    for (int n_run = 0; n_run < n_io_runs; ++n_run) {
+        auto start = std::chrono::high_resolution_clock::now();
+        const int64_t whole_result = solve(read_data(path));
+        auto middle = std::chrono::high_resolution_clock::now();
+        std::ifstream file { path, std::ios::binary };
+        const int64_t stream_result = solve_stream(file);
+        auto end = std::chrono::high_resolution_clock::now();
+        time_whole_total += std::chrono::duration<double, std::nano>(middle - start).count();
+        time_stream_total += std::chrono::duration<double, std::nano>(end - middle).count();
+        if (whole_result != stream_result) {
+            std::fprintf(stderr, "Whole file total %lld, streamed total %lld\n", whole_result, stream_result);
+            return 1;
+        }
+    }
+    std::printf(
+        "Average ns (whole file): %d, input bytes held: %zu\n",
+        static_cast<int>(std::round(time_whole_total / n_io_runs)),
+        data.length());
+    std::printf(
+        "Average ns (streamed): %d, buffer bytes: %zu\n",
+        static_cast<int>(std::round(time_stream_total / n_io_runs)),
+        stream_buffer_size);
 #else
-    std::printf("%d\n", solve(data));
+    std::printf("%lld\n", solve(data));
 #endif
 }
\ No newline at end of file
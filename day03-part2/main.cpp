@@ -1,8 +1,22 @@
+#include <algorithm>
+#include <array>
+#include <bit>
 #include <chrono>
 #include <cmath>
+#include <cstdint>
 #include <filesystem>
 #include <fstream>
+#include <istream>
+#include <optional>
 #include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
 
 static std::string read_data(const std::filesystem::path& path)
 {
@@ -17,25 +31,32 @@ static bool is_digit(const char c)
     return c >= '0' && c <= '9';
 }
 
-static std::optional<int> parse_int_opt(const std::string& string, int& pos)
+// Mul operands are 1 to 3 digit numbers, which also keeps every product well inside an int
+constexpr int max_operand_digits = 3;
+
+static std::optional<int> parse_int_opt(const std::string& string, size_t& pos)
 {
     if (!is_digit(string[pos])) {
         return std::nullopt;
     }
     int result = 0;
+    int n_digits = 0;
     do {
+        if (++n_digits > max_operand_digits) {
+            return std::nullopt;
+        }
         result = result * 10 + (string[pos] - '0');
         ++pos;
     } while (is_digit(string[pos]) && pos < string.length());
     return result;
 }
 
-static bool substr_equals_at(const std::string& string, const std::string& value, const int pos)
+static bool substr_equals_at(const std::string& string, const std::string_view value, const size_t pos)
 {
     if (pos + value.length() >= string.length()) {
         return false;
     }
-    for (int i = 0; i < value.length(); ++i) {
+    for (size_t i = 0; i < value.length(); ++i) {
         if (string[pos + i] != value[i]) {
             return false;
         }
@@ -43,7 +64,7 @@ static bool substr_equals_at(const std::string& string, const std::string& value
     return true;
 }
 
-static std::optional<int> parse_mul(const std::string& string, int& pos)
+static std::optional<int> parse_mul(const std::string& string, size_t& pos)
 {
     if (pos + 8 >= string.length()) {
         return std::nullopt;
@@ -51,7 +72,7 @@ static std::optional<int> parse_mul(const std::string& string, int& pos)
     if (!substr_equals_at(string, "mul(", pos)) {
         return std::nullopt;
     }
-    const int saved_pos = pos;
+    const size_t saved_pos = pos;
     pos += 4;
     const std::optional<int> value1 = parse_int_opt(string, pos);
     if (!value1.has_value() || pos >= string.length() || string[pos] != ',') {
@@ -68,50 +89,297 @@ static std::optional<int> parse_mul(const std::string& string, int& pos)
     return value1.value() * value2.value();
 }
 
-static bool parse_do(const std::string& string, int& pos)
+static bool parse_do(const std::string& string, size_t& pos)
 {
-    if (const std::string key = "do()"; substr_equals_at(string, key, pos)) {
-        pos += static_cast<int>(key.length());
+    if (constexpr std::string_view key = "do()"; substr_equals_at(string, key, pos)) {
+        pos += key.length();
         return true;
     }
     return false;
 }
 
-static bool parse_dont(const std::string& string, int& pos)
+static bool parse_dont(const std::string& string, size_t& pos)
 {
-    if (const std::string key = "don't()"; substr_equals_at(string, key, pos)) {
-        pos += static_cast<int>(key.length());
+    if (constexpr std::string_view key = "don't()"; substr_equals_at(string, key, pos)) {
+        pos += key.length();
         return true;
     }
     return false;
 }
 
-static int solve(const std::string& data)
+// Bit i is set if ptr[i] == c, for i in [0, 32)
+static uint32_t byte_mask_32(const char* ptr, const char c)
+{
+#if defined(__AVX2__)
+    const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr));
+    return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, _mm256_set1_epi8(c))));
+#elif defined(__SSE2__) || defined(_M_X64)
+    const __m128i needle = _mm_set1_epi8(c);
+    const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr));
+    const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr + 16));
+    return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(low, needle)))
+        | static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(high, needle))) << 16;
+#else
+    uint32_t mask = 0;
+    for (int i = 0; i < 32; ++i) {
+        mask |= static_cast<uint32_t>(ptr[i] == c) << i;
+    }
+    return mask;
+#endif
+}
+
+// Positions in [ptr, ptr + 32) that start with "mul(" or "do", reads up to ptr + 35
+static uint32_t token_candidates(const char* ptr)
+{
+    const uint32_t mul_mask = byte_mask_32(ptr, 'm') & byte_mask_32(ptr + 1, 'u') & byte_mask_32(ptr + 2, 'l')
+        & byte_mask_32(ptr + 3, '(');
+    const uint32_t do_mask = byte_mask_32(ptr, 'd') & byte_mask_32(ptr + 1, 'o');
+    return mul_mask | do_mask;
+}
+
+// Result of scanning a chunk without knowing whether muls are enabled at its start
+struct ChunkSummary {
+    int64_t enabled_total = 0;
+    int64_t disabled_total = 0;
+    std::optional<bool> final_enabled; // Set by the last do() or don't() in the chunk
+};
+
+// Associative, so chunks can be summarized independently and combined in order
+static ChunkSummary merge(const ChunkSummary& first, const ChunkSummary& second)
+{
+    const bool second_enabled_if_enabled = first.final_enabled.value_or(true);
+    const bool second_enabled_if_disabled = first.final_enabled.value_or(false);
+    return {
+        .enabled_total = first.enabled_total
+            + (second_enabled_if_enabled ? second.enabled_total : second.disabled_total),
+        .disabled_total = first.disabled_total
+            + (second_enabled_if_disabled ? second.enabled_total : second.disabled_total),
+        .final_enabled = second.final_enabled.has_value() ? second.final_enabled : first.final_enabled
+    };
+}
+
+static void parse_token_at(const std::string& data, size_t pos, std::array<bool, 2>& enabled, ChunkSummary& summary)
+{
+    if (data[pos] == 'd') {
+        if (parse_do(data, pos)) {
+            enabled[0] = enabled[1] = true;
+            summary.final_enabled = true;
+        }
+        else if (parse_dont(data, pos)) {
+            enabled[0] = enabled[1] = false;
+            summary.final_enabled = false;
+        }
+    }
+    else if (enabled[0] || enabled[1]) {
+        if (const std::optional<int> result = parse_mul(data, pos); result.has_value()) {
+            summary.enabled_total += enabled[0] ? result.value() : 0;
+            summary.disabled_total += enabled[1] ? result.value() : 0;
+        }
+    }
+}
+
+// Summarizes the tokens starting in [begin, end), tokens may extend past end
+static ChunkSummary summarize_chunk(const std::string& data, const size_t begin, const size_t end)
 {
-    int total = 0;
-    bool enabled = true;
-    for (int pos = 0; pos < data.length(); ++pos) {
-        if (!enabled && parse_do(data, pos)) {
-            enabled = true;
-            --pos;
-        }
-        else if (enabled) {
-            if (parse_dont(data, pos)) {
-                enabled = false;
-                --pos;
+    ChunkSummary summary;
+    // Whether muls are enabled if the chunk started enabled and disabled respectively
+    std::array enabled { true, false };
+    size_t pos = begin;
+    // Only the candidates found 32 bytes at a time are handed to the full parsers
+    for (; pos + 32 <= end && pos + 35 < data.length(); pos += 32) {
+        for (uint32_t mask = token_candidates(data.data() + pos); mask != 0; mask &= mask - 1) {
+            parse_token_at(data, pos + std::countr_zero(mask), enabled, summary);
+        }
+    }
+    for (; pos < end; ++pos) {
+        if (data[pos] == 'm' || data[pos] == 'd') {
+            parse_token_at(data, pos, enabled, summary);
+        }
+    }
+    return summary;
+}
+
+static int64_t solve(const std::string& data)
+{
+    // Below this much input per thread the chunks are not worth a thread each
+    constexpr size_t min_chunk_size = 1 << 20;
+    const size_t n_chunks = std::clamp<size_t>(
+        data.length() / min_chunk_size, 1, std::max(std::thread::hardware_concurrency(), 1u));
+    if (n_chunks == 1) {
+        return summarize_chunk(data, 0, data.length()).enabled_total;
+    }
+    std::vector<ChunkSummary> summaries(n_chunks);
+    {
+        std::vector<std::jthread> workers;
+        workers.reserve(n_chunks);
+        const size_t chunk_size = data.length() / n_chunks;
+        for (size_t i = 0; i < n_chunks; ++i) {
+            const size_t begin = i * chunk_size;
+            const size_t end = i == n_chunks - 1 ? data.length() : begin + chunk_size;
+            workers.emplace_back([&data, &summaries, i, begin, end] {
+                summaries[i] = summarize_chunk(data, begin, end);
+            });
+        }
+    }
+    ChunkSummary total = summaries[0];
+    for (size_t i = 1; i < n_chunks; ++i) {
+        total = merge(total, summaries[i]);
+    }
+    return total.enabled_total;
+}
+
+#ifdef BENCHMARK
+// Resumable parser that takes the input in blocks of any size, tokens may be split across blocks
+class StreamParser {
+public:
+    void feed(const std::string_view block)
+    {
+        size_t pos = 0;
+        while (pos < block.length()) {
+            if (m_state == State::idle) {
+                pos = next_token_start(block, pos);
+                if (pos == block.length()) {
+                    break;
+                }
             }
-            else if (const std::optional<int> result = parse_mul(data, pos); result.has_value()) {
-                total += result.value();
-                --pos;
+            step(block[pos]);
+            ++pos;
+        }
+    }
+
+    [[nodiscard]] int64_t total() const
+    {
+        return m_total;
+    }
+
+private:
+    enum class State { idle, literal, first_operand, second_operand };
+
+    static constexpr std::string_view mul_key = "mul(";
+    static constexpr std::string_view do_key = "do()";
+    static constexpr std::string_view dont_key = "don't()";
+
+    static size_t next_token_start(const std::string_view block, size_t pos)
+    {
+        for (; pos + 35 < block.length(); pos += 32) {
+            if (const uint32_t mask = token_candidates(block.data() + pos); mask != 0) {
+                return pos + std::countr_zero(mask);
             }
         }
+        while (pos < block.length() && block[pos] != 'm' && block[pos] != 'd') {
+            ++pos;
+        }
+        return pos;
+    }
+
+    void step(const char c)
+    {
+        switch (m_state) {
+        case State::idle:
+            break;
+        case State::literal:
+            if (c == m_literal[m_literal_pos]) {
+                if (++m_literal_pos == m_literal.length()) {
+                    finish_literal();
+                }
+                return;
+            }
+            if (m_literal == do_key && m_literal_pos == 2 && c == dont_key[2]) {
+                m_literal = dont_key;
+                ++m_literal_pos;
+                return;
+            }
+            break;
+        case State::first_operand:
+            if (is_digit(c) && m_n_digits < max_operand_digits) {
+                m_first = m_first * 10 + (c - '0');
+                ++m_n_digits;
+                return;
+            }
+            if (c == ',' && m_n_digits > 0) {
+                m_state = State::second_operand;
+                m_n_digits = 0;
+                return;
+            }
+            break;
+        case State::second_operand:
+            if (is_digit(c) && m_n_digits < max_operand_digits) {
+                m_second = m_second * 10 + (c - '0');
+                ++m_n_digits;
+                return;
+            }
+            if (c == ')' && m_n_digits > 0) {
+                if (m_enabled) {
+                    m_total += m_first * m_second;
+                }
+                m_state = State::idle;
+                return;
+            }
+            break;
+        }
+        // No token continues with c, but c may start a new one
+        start_token(c);
+    }
+
+    void start_token(const char c)
+    {
+        m_state = State::idle;
+        if (c == 'm') {
+            m_literal = mul_key;
+        }
+        else if (c == 'd') {
+            m_literal = do_key;
+        }
+        else {
+            return;
+        }
+        m_state = State::literal;
+        m_literal_pos = 1;
+    }
+
+    void finish_literal()
+    {
+        m_state = State::idle;
+        if (m_literal == mul_key) {
+            m_state = State::first_operand;
+            m_first = 0;
+            m_second = 0;
+            m_n_digits = 0;
+        }
+        else {
+            m_enabled = m_literal == do_key;
+        }
     }
-    return total;
+
+    State m_state = State::idle;
+    std::string_view m_literal;
+    size_t m_literal_pos = 0;
+    int64_t m_first = 0;
+    int64_t m_second = 0;
+    int m_n_digits = 0;
+    bool m_enabled = true;
+    int64_t m_total = 0;
+};
+
+constexpr size_t stream_buffer_size = 64 * 1024;
+
+// Memory use is bounded by the buffer size regardless of input size
+static int64_t solve_stream(std::istream& stream)
+{
+    StreamParser parser;
+    std::array<char, stream_buffer_size> buffer;
+    while (stream) {
+        stream.read(buffer.data(), buffer.size());
+        parser.feed({ buffer.data(), static_cast<size_t>(stream.gcount()) });
+    }
+    return parser.total();
 }
+#endif
 
 int main()
 {
-    const std::string data = read_data("./day03-part2/input.txt");
+    const std::filesystem::path path = "./day03-part2/input.txt";
+    const std::string data = read_data(path);
 
 #ifdef BENCHMARK
     constexpr int n_runs = 100000;
@@ -122,12 +390,39 @@ int main()
         // ReSharper disable once CppDFAUnusedValue
         // ReSharper disable once CppDFAUnreadVariable
         // ReSharper disable once CppDeclaratorNeverUsed
-        volatile int result = solve(data);
+        volatile int64_t result = solve(data);
         auto end = std::chrono::high_resolution_clock::now();
         time_running_total += std::chrono::duration<double, std::nano>(end - start).count();
     }
     std::printf("Average ns: %d\n", static_cast<int>(std::round(time_running_total / n_runs)));
+
+    // Reading the whole file compared to streaming it, both including I/O
+    constexpr int n_io_runs = 10000;
+    double time_whole_total = 0.0;
+    double time_stream_total = 0.0;
+    for (int n_run = 0; n_run < n_io_runs; ++n_run) {
+        auto start = std::chrono::high_resolution_clock::now();
+        const int64_t whole_result = solve(read_data(path));
+        auto middle = std::chrono::high_resolution_clock::now();
+        std::ifstream file { path, std::ios::binary };
+        const int64_t stream_result = solve_stream(file);
+        auto end = std::chrono::high_resolution_clock::now();
+        time_whole_total += std::chrono::duration<double, std::nano>(middle - start).count();
+        time_stream_total += std::chrono::duration<double, std::nano>(end - middle).count();
+        if (whole_result != stream_result) {
+            std::fprintf(stderr, "Whole file total %lld, streamed total %lld\n", whole_result, stream_result);
+            return 1;
+        }
+    }
+    std::printf(
+        "Average ns (whole file): %d, input bytes held: %zu\n",
+        static_cast<int>(std::round(time_whole_total / n_io_runs)),
+        data.length());
+    std::printf(
+        "Average ns (streamed): %d, buffer bytes: %zu\n",
+        static_cast<int>(std::round(time_stream_total / n_io_runs)),
+        stream_buffer_size);
 #else
-    std::printf("%d\n", solve(data));
+    std::printf("%lld\n", solve(data));
 #endif
 }
\ No newline at end of file
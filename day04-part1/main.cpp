@@ -1,9 +1,17 @@
+#include <algorithm>
 #include <array>
+#include <bit>
+#include <cassert>
 #include <chrono>
 #include <cmath>
+#include <cstdint>
 #include <filesystem>
 #include <fstream>
+#include <queue>
+#include <random>
 #include <sstream>
+#include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 
@@ -15,124 +23,419 @@ static std::string read_data(const std::filesystem::path& path)
     return ss.str();
 }
 
+// One bit per cell for a single letter, each row padded with a zero word so reads shifted past the end stay in
+// the row
+class Bitboard {
+public:
+    Bitboard(const int width, const int height)
+        : m_row_words { (width + 63) / 64 + 1 }
+        , m_words(static_cast<size_t>(m_row_words) * height, 0)
+    {
+    }
+
+    void set(const int x, const int y)
+    {
+        m_words[y * m_row_words + x / 64] |= uint64_t { 1 } << (x % 64);
+    }
+
+    // 64 cells of row y starting at column word * 64 + shift, shift must be less than 64
+    [[nodiscard]] uint64_t shifted_word(const int y, const int word, const int shift) const
+    {
+        const uint64_t* row = m_words.data() + y * m_row_words;
+        if (shift == 0) {
+            return row[word];
+        }
+        return row[word] >> shift | row[word + 1] << (64 - shift);
+    }
+
+private:
+    int m_row_words;
+    std::vector<uint64_t> m_words;
+};
+
+#ifdef BENCHMARK
 struct Vector2i {
     int x;
     int y;
+};
+
+// Aho-Corasick automaton with a complete transition table over the letters that appear in the patterns, so every
+// step is one lookup no matter how many patterns there are
+class PatternAutomaton {
+public:
+    explicit PatternAutomaton(const std::vector<std::string>& patterns)
+    {
+        // Letter 0 stands for every character that appears in no pattern
+        m_letter_indices.fill(0);
+        for (const std::string& pattern : patterns) {
+            for (const char c : pattern) {
+                if (uint8_t& index = m_letter_indices[static_cast<unsigned char>(c)]; index == 0) {
+                    index = static_cast<uint8_t>(m_n_letters++);
+                }
+            }
+        }
+        add_state();
+        for (int id = 0; id < patterns.size(); ++id) {
+            int state = 0;
+            for (const char c : patterns[id]) {
+                const int letter = m_letter_indices[static_cast<unsigned char>(c)];
+                if (m_transitions[state * m_n_letters + letter] == 0) {
+                    const int child = add_state();
+                    m_transitions[state * m_n_letters + letter] = child;
+                }
+                state = m_transitions[state * m_n_letters + letter];
+            }
+            ++m_match_counts[state];
+            if (m_pattern_ids[state] == -1) {
+                m_pattern_ids[state] = id;
+            }
+        }
+        build_links();
+    }
+
+    [[nodiscard]] int next(const int state, const char c) const
+    {
+        return m_transitions[state * m_n_letters + m_letter_indices[static_cast<unsigned char>(c)]];
+    }
+
+    // Number of patterns, counting duplicates, that end at this state
+    [[nodiscard]] int match_count(const int state) const
+    {
+        return m_match_counts[state];
+    }
+
+    // Calls func with the id of each distinct pattern that ends at this state
+    template <typename Func>
+    void for_each_match(int state, Func&& func) const
+    {
+        if (m_pattern_ids[state] == -1) {
+            state = m_dict_links[state];
+        }
+        while (state != -1) {
+            func(m_pattern_ids[state]);
+            state = m_dict_links[state];
+        }
+    }
+
+private:
+    int add_state()
+    {
+        m_transitions.resize(m_transitions.size() + m_n_letters, 0);
+        m_match_counts.push_back(0);
+        m_pattern_ids.push_back(-1);
+        return static_cast<int>(m_match_counts.size()) - 1;
+    }
 
-    Vector2i& operator+=(const Vector2i& other)
+    // Breadth first so the failure state of each state is finished before the state itself
+    void build_links()
     {
-        x += other.x;
-        y += other.y;
-        return *this;
+        std::vector<int> fail_links(m_match_counts.size(), 0);
+        m_dict_links.assign(m_match_counts.size(), -1);
+        std::queue<int> queue;
+        for (int letter = 0; letter < m_n_letters; ++letter) {
+            if (const int child = m_transitions[letter]; child != 0) {
+                queue.push(child);
+            }
+        }
+        while (!queue.empty()) {
+            const int state = queue.front();
+            queue.pop();
+            const int fail = fail_links[state];
+            m_match_counts[state] += m_match_counts[fail];
+            m_dict_links[state] = m_pattern_ids[fail] != -1 ? fail : m_dict_links[fail];
+            for (int letter = 0; letter < m_n_letters; ++letter) {
+                int& transition = m_transitions[state * m_n_letters + letter];
+                const int fail_transition = m_transitions[fail * m_n_letters + letter];
+                if (transition == 0) {
+                    transition = fail_transition;
+                }
+                else {
+                    fail_links[transition] = fail_transition;
+                    queue.push(transition);
+                }
+            }
+        }
     }
+
+    std::array<uint8_t, 256> m_letter_indices {};
+    int m_n_letters = 1;
+    std::vector<int> m_transitions;
+    std::vector<int> m_match_counts;
+    std::vector<int> m_pattern_ids;
+    std::vector<int> m_dict_links;
 };
+#endif
 
 class WordSearch {
 public:
     static WordSearch parse(const std::string& string)
     {
-        std::optional<int> width;
-        std::vector<char> board;
-        int pos = 0;
-        while (pos < string.length()) {
-            while (string[pos] != '\n') {
-                board.push_back(string[pos]);
-                ++pos;
-            }
-            if (!width.has_value()) {
-                width = pos;
+        const int width = static_cast<int>(string.find('\n'));
+        const int height = static_cast<int>(string.length() + 1) / (width + 1);
+        WordSearch search { width, height };
+#ifdef BENCHMARK
+        search.m_cells.reserve(static_cast<size_t>(width) * height);
+#endif
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                const char c = string[y * (width + 1) + x];
+                search.board_for(c).set(x, y);
+#ifdef BENCHMARK
+                search.m_cells.push_back(c);
+#endif
             }
-            ++pos;
         }
-        return WordSearch { width.value(), std::move(board) };
+        return search;
     }
 
+    // Counts occurrences in all 8 directions, 64 cells of a row at a time
     [[nodiscard]] int search_word_count(const std::string& word) const
     {
-        constexpr std::array dirs { Dir::north, Dir::northeast, Dir::east, Dir::southeast,
-                                    Dir::south, Dir::southwest, Dir::west, Dir::northwest };
+        assert(!word.empty() && word.length() <= 64);
+        std::string reversed = word;
+        std::ranges::reverse(reversed);
+        // Searching the reversed word covers the opposite direction
+        constexpr std::array<std::pair<int, int>, 4> dirs { { { 1, 0 }, { 0, 1 }, { 1, 1 }, { 1, -1 } } };
         int count = 0;
-        for (int y = 0; y < m_size.y; ++y) {
-            for (int x = 0; x < m_size.x; ++x) {
-                if (at({ x, y }).value() != word[0]) {
-                    continue;
-                }
-                for (const Dir dir : dirs) {
-                    if (word_at(word, { x, y }, dir)) {
-                        ++count;
-                    }
-                }
+        for (const auto& [dx, dy] : dirs) {
+            count += dir_count(word, dx, dy) + dir_count(reversed, dx, dy);
+        }
+        return count;
+    }
+
+#ifdef BENCHMARK
+    // Includes each word's reverse so scanning a line in one direction also finds the opposite direction
+    static PatternAutomaton make_words_automaton(const std::vector<std::string>& words)
+    {
+        std::vector<std::string> patterns = words;
+        for (const std::string& word : words) {
+            patterns.emplace_back(word.rbegin(), word.rend());
+        }
+        return PatternAutomaton { patterns };
+    }
+
+    // Counts occurrences of a whole dictionary in all 8 directions with one pass over every row, column, diagonal
+    // and anti-diagonal, automaton should come from make_words_automaton
+    [[nodiscard]] int64_t search_words_count(const PatternAutomaton& automaton) const
+    {
+        int64_t count = 0;
+        const auto scan_line = [&](int x, int y, const int dx, const int dy) {
+            int state = 0;
+            for (; x >= 0 && x < m_width && y < m_height; x += dx, y += dy) {
+                state = automaton.next(state, m_cells[y * m_width + x]);
+                count += automaton.match_count(state);
+            }
+        };
+        for (int y = 0; y < m_height; ++y) {
+            scan_line(0, y, 1, 0);
+            scan_line(0, y, 1, 1);
+            scan_line(m_width - 1, y, -1, 1);
+        }
+        for (int x = 0; x < m_width; ++x) {
+            scan_line(x, 0, 0, 1);
+            if (x > 0) {
+                scan_line(x, 0, 1, 1);
+            }
+            if (x < m_width - 1) {
+                scan_line(x, 0, -1, 1);
             }
         }
         return count;
     }
 
-private:
-    enum class Dir { north, northeast, east, southeast, south, southwest, west, northwest };
+    [[nodiscard]] std::string_view row(const int y) const
+    {
+        return std::string_view { m_cells }.substr(static_cast<size_t>(y) * m_width, m_width);
+    }
 
-    WordSearch(const int width, std::vector<char> board)
-        : m_board { std::move(board) }
-        , m_size { width, static_cast<int>(m_board.size()) / width }
+    [[nodiscard]] Vector2i size() const
     {
+        return { m_width, m_height };
     }
+#endif
 
-    [[nodiscard]] bool in_bounds(const Vector2i& pos) const
+private:
+    WordSearch(const int width, const int height)
+        : m_width { width }
+        , m_height { height }
     {
-        return pos.x >= 0 && pos.x < m_size.x && pos.y >= 0 && pos.y < m_size.y;
+        m_board_indices.fill(-1);
     }
 
-    [[nodiscard]] std::optional<char> at(const Vector2i& pos) const
+    Bitboard& board_for(const char letter)
     {
-        if (!in_bounds(pos)) {
-            return std::nullopt;
+        int& index = m_board_indices[static_cast<unsigned char>(letter)];
+        if (index == -1) {
+            index = static_cast<int>(m_boards.size());
+            m_boards.emplace_back(m_width, m_height);
         }
-        return m_board[index(pos)];
+        return m_boards[index];
     }
 
-    [[nodiscard]] int index(const Vector2i& pos) const
+    // Occurrences with letter i at (x + i * dx, y + i * dy), dx is 0 or 1
+    [[nodiscard]] int dir_count(const std::string& word, const int dx, const int dy) const
     {
-        return pos.y * m_size.x + pos.x;
+        const int length = static_cast<int>(word.length());
+        std::array<const Bitboard*, 64> boards {};
+        for (int i = 0; i < length; ++i) {
+            const int index = m_board_indices[static_cast<unsigned char>(word[i])];
+            if (index == -1) {
+                return 0;
+            }
+            boards[i] = &m_boards[index];
+        }
+        const int y_begin = dy < 0 ? length - 1 : 0;
+        const int y_end = dy > 0 ? m_height - length + 1 : m_height;
+        const int n_words = (m_width + 63) / 64;
+        int count = 0;
+        for (int y = y_begin; y < y_end; ++y) {
+            for (int w = 0; w < n_words; ++w) {
+                uint64_t matches = ~uint64_t { 0 };
+                for (int i = 0; i < length; ++i) {
+                    matches &= boards[i]->shifted_word(y + i * dy, w, i * dx);
+                }
+                count += std::popcount(matches);
+            }
+        }
+        return count;
+    }
+
+    int m_width;
+    int m_height;
+    std::array<int, 256> m_board_indices {};
+    std::vector<Bitboard> m_boards;
+#ifdef BENCHMARK
+    std::string m_cells;
+#endif
+};
+
+#ifdef BENCHMARK
+// Rows of a small 2D pattern, '.' matches any letter
+using Stencil = std::vector<std::string>;
+
+// Rotates 90 degrees clockwise
+static Stencil rotated(const Stencil& stencil)
+{
+    const int height = static_cast<int>(stencil.size());
+    const int width = static_cast<int>(stencil[0].length());
+    Stencil result(width, std::string(height, '.'));
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            result[x][height - 1 - y] = stencil[y][x];
+        }
     }
+    return result;
+}
 
-    static Vector2i word_dir_offset(const Dir dir)
+// Matches the wildcard-free runs in the rows of every stencil with one automaton pass per grid row. Each run found
+// votes for the stencil origin it implies and a stencil matches at an origin once all of its runs have voted.
+class StencilSearch {
+public:
+    static StencilSearch create(const std::vector<Stencil>& stencils)
     {
-        switch (dir) {
-        case Dir::north:
-            return { 0, -1 };
-        case Dir::northeast:
-            return { 1, -1 };
-        case Dir::east:
-            return { 1, 0 };
-        case Dir::southeast:
-            return { 1, 1 };
-        case Dir::south:
-            return { 0, 1 };
-        case Dir::southwest:
-            return { -1, 1 };
-        case Dir::west:
-            return { -1, 0 };
-        case Dir::northwest:
-            return { -1, -1 };
+        std::vector<std::string> runs;
+        std::vector<std::vector<RunPlacement>> run_placements;
+        std::vector<StencilInfo> infos;
+        for (int stencil = 0; stencil < stencils.size(); ++stencil) {
+            StencilInfo info {
+                .size = { static_cast<int>(stencils[stencil][0].length()), static_cast<int>(stencils[stencil].size()) },
+                .n_runs = 0
+            };
+            for (int y = 0; y < info.size.y; ++y) {
+                const std::string& row = stencils[stencil][y];
+                for (int x = 0; x < row.length();) {
+                    if (row[x] == '.') {
+                        ++x;
+                        continue;
+                    }
+                    const int run_start = x;
+                    while (x < row.length() && row[x] != '.') {
+                        ++x;
+                    }
+                    const std::string run = row.substr(run_start, x - run_start);
+                    auto it = std::ranges::find(runs, run);
+                    if (it == runs.end()) {
+                        runs.push_back(run);
+                        run_placements.emplace_back();
+                        it = runs.end() - 1;
+                    }
+                    run_placements[it - runs.begin()].push_back({ .stencil = stencil, .end = { x - 1, y } });
+                    ++info.n_runs;
+                }
+            }
+            assert(info.n_runs <= 255);
+            infos.push_back(info);
         }
-        std::unreachable();
+        return StencilSearch { PatternAutomaton { runs }, std::move(run_placements), std::move(infos) };
     }
 
-    [[nodiscard]] bool word_at(const std::string& word, const Vector2i& pos, const Dir dir) const
+    [[nodiscard]] int64_t count_matches(const WordSearch& grid) const
     {
-        const Vector2i offset = word_dir_offset(dir);
-        Vector2i current = pos;
-        for (int i = 0; i < word.length(); ++i) {
-            if (std::optional<char> c = at(current); !c.has_value() || word[i] != c.value()) {
-                return false;
+        const auto [width, height] = grid.size();
+        const int n_stencils = static_cast<int>(m_infos.size());
+        int64_t count = 0;
+        int window = 1;
+        for (const StencilInfo& info : m_infos) {
+            window = std::max(window, info.size.y);
+            // Only wildcards, so it matches wherever it fits
+            if (info.n_runs == 0) {
+                count += static_cast<int64_t>(std::max(width - info.size.x + 1, 0))
+                    * std::max(height - info.size.y + 1, 0);
             }
-            current += offset;
         }
-        return true;
+        // Votes for the origins in the last window rows, indexed by origin row modulo window
+        std::vector<uint8_t> votes(static_cast<size_t>(window) * n_stencils * width, 0);
+        for (int y = 0; y < height; ++y) {
+            // Origins in this slot are window rows up and can't receive any more votes
+            std::fill_n(votes.begin() + static_cast<ptrdiff_t>(y % window) * n_stencils * width, n_stencils * width, 0);
+            const std::string_view row = grid.row(y);
+            int state = 0;
+            for (int x = 0; x < width; ++x) {
+                state = m_automaton.next(state, row[x]);
+                m_automaton.for_each_match(state, [&](const int run) {
+                    for (const auto& [stencil, end] : m_run_placements[run]) {
+                        const StencilInfo& info = m_infos[stencil];
+                        const Vector2i origin { x - end.x, y - end.y };
+                        if (origin.x < 0 || origin.y < 0 || origin.x + info.size.x > width
+                            || origin.y + info.size.y > height) {
+                            continue;
+                        }
+                        if (++votes[((origin.y % window) * n_stencils + stencil) * width + origin.x] == info.n_runs) {
+                            ++count;
+                        }
+                    }
+                });
+            }
+        }
+        return count;
     }
 
-    std::vector<char> m_board;
-    Vector2i m_size;
+private:
+    struct RunPlacement {
+        int stencil;
+        Vector2i end; // Position of the run's last letter relative to the stencil origin
+    };
+
+    struct StencilInfo {
+        Vector2i size;
+        int n_runs;
+    };
+
+    StencilSearch(
+        PatternAutomaton automaton,
+        std::vector<std::vector<RunPlacement>> run_placements,
+        std::vector<StencilInfo> infos)
+        : m_automaton { std::move(automaton) }
+        , m_run_placements { std::move(run_placements) }
+        , m_infos { std::move(infos) }
+    {
+    }
+
+    PatternAutomaton m_automaton;
+    std::vector<std::vector<RunPlacement>> m_run_placements;
+    std::vector<StencilInfo> m_infos;
 };
+#endif
 
 static int solve(const std::string& data)
 {
@@ -158,6 +461,75 @@ int main()
         time_running_total += std::chrono::duration<double, std::nano>(end - start).count();
     }
     std::printf("Average ns: %d\n", static_cast<int>(std::round(time_running_total / n_runs)));
+
+    // Dictionary search time should stay flat as the dictionary grows
+    const WordSearch search = WordSearch::parse(data);
+    std::mt19937 rng { 2024 };
+    std::uniform_int_distribution length_dist { 3, 8 };
+    std::uniform_int_distribution letter_dist { 0, 3 };
+    std::vector<std::string> words { "XMAS" };
+    for (const int n_words : { 1, 16, 256, 4096 }) {
+        while (words.size() < n_words) {
+            std::string word;
+            for (int i = length_dist(rng); i > 0; --i) {
+                word.push_back("XMAS"[letter_dist(rng)]);
+            }
+            words.push_back(std::move(word));
+        }
+        const PatternAutomaton automaton = WordSearch::make_words_automaton(words);
+        int64_t expected = 0;
+        for (const std::string& word : words) {
+            expected += search.search_word_count(word);
+        }
+        if (const int64_t count = search.search_words_count(automaton); count != expected) {
+            std::fprintf(
+                stderr, "%d word dictionary: %lld matches, %lld searching word by word\n", n_words, count, expected);
+            return 1;
+        }
+        constexpr int n_dictionary_runs = 1000;
+        double time_dictionary_total = 0.0;
+        for (int n_run = 0; n_run < n_dictionary_runs; ++n_run) {
+            auto start = std::chrono::high_resolution_clock::now();
+            // ReSharper disable once CppDFAUnusedValue
+            // ReSharper disable once CppDFAUnreadVariable
+            // ReSharper disable once CppDeclaratorNeverUsed
+            volatile int64_t result = search.search_words_count(automaton);
+            auto end = std::chrono::high_resolution_clock::now();
+            time_dictionary_total += std::chrono::duration<double, std::nano>(end - start).count();
+        }
+        std::printf(
+            "Average ns (%d word dictionary): %d\n",
+            n_words,
+            static_cast<int>(std::round(time_dictionary_total / n_dictionary_runs)));
+    }
+
+    // The word as stencils in all 8 directions, straight ones and their rotations and diagonal ones and theirs
+    std::vector<Stencil> stencils { { "XMAS" } };
+    stencils.push_back({ "X...", ".M..", "..A.", "...S" });
+    for (int i = 0; i < 3; ++i) {
+        stencils.push_back(rotated(stencils[stencils.size() - 2]));
+        stencils.push_back(rotated(stencils[stencils.size() - 2]));
+    }
+    const StencilSearch stencil_search = StencilSearch::create(stencils);
+    if (const int64_t count = stencil_search.count_matches(search), expected = search.search_word_count("XMAS");
+        count != expected) {
+        std::fprintf(stderr, "Stencil search: %lld matches, %lld searching the word\n", count, expected);
+        return 1;
+    }
+    constexpr int n_stencil_runs = 1000;
+    double time_stencil_total = 0.0;
+    for (int n_run = 0; n_run < n_stencil_runs; ++n_run) {
+        auto start = std::chrono::high_resolution_clock::now();
+        // ReSharper disable once CppDFAUnusedValue
+        // ReSharper disable once CppDFAUnreadVariable
+        // ReSharper disable once CppDeclaratorNeverUsed
+        volatile int64_t result = stencil_search.count_matches(search);
+        auto end = std::chrono::high_resolution_clock::now();
+        time_stencil_total += std::chrono::duration<double, std::nano>(end - start).count();
+    }
+    std::printf(
+        "Average ns (stencil search, 8 directions): %d\n",
+        static_cast<int>(std::round(time_stencil_total / n_stencil_runs)));
 #else
     std::printf("%d\n", solve(data));
 #endif
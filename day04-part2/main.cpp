@@ -1,12 +1,23 @@
+#include <algorithm>
 #include <array>
+#include <bit>
 #include <chrono>
 #include <cmath>
+#include <cstdint>
 #include <filesystem>
 #include <fstream>
+#include <optional>
 #include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
 #include <utility>
 #include <vector>
 
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
 static std::string read_data(const std::filesystem::path& path)
 {
     const std::fstream file { path };
@@ -18,19 +29,10 @@ static std::string read_data(const std::filesystem::path& path)
 struct Vector2i {
     int x;
     int y;
-
-    Vector2i& operator+=(const Vector2i& other)
-    {
-        x += other.x;
-        y += other.y;
-        return *this;
-    }
 };
 
 class WordSearch {
 public:
-    enum class Dir { north, northeast, east, southeast, south, southwest, west, northwest };
-
     static WordSearch parse(const std::string& string)
     {
         std::optional<int> width;
@@ -49,30 +51,9 @@ public:
         return WordSearch { width.value(), std::move(board) };
     }
 
-    [[nodiscard]] bool word_at(const std::string& word, const Vector2i& pos, const Dir dir) const
-    {
-        const Vector2i offset = word_dir_offset(dir);
-        Vector2i current = pos;
-        for (int i = 0; i < word.length(); ++i) {
-            if (std::optional<char> c = at(current); !c.has_value() || word[i] != c.value()) {
-                return false;
-            }
-            current += offset;
-        }
-        return true;
-    }
-
-    [[nodiscard]] bool in_bounds(const Vector2i& pos) const
-    {
-        return pos.x >= 0 && pos.x < m_size.x && pos.y >= 0 && pos.y < m_size.y;
-    }
-
-    [[nodiscard]] std::optional<char> at(const Vector2i& pos) const
+    [[nodiscard]] std::string_view row(const int y) const
     {
-        if (!in_bounds(pos)) {
-            return std::nullopt;
-        }
-        return m_board[index(pos)];
+        return { m_board.data() + static_cast<size_t>(y) * m_size.x, static_cast<size_t>(m_size.x) };
     }
 
     [[nodiscard]] Vector2i size() const
@@ -87,58 +68,125 @@ private:
     {
     }
 
-    [[nodiscard]] int index(const Vector2i& pos) const
-    {
-        return pos.y * m_size.x + pos.x;
-    }
-
-    static Vector2i word_dir_offset(const Dir dir)
-    {
-        switch (dir) {
-        case Dir::north:
-            return { 0, -1 };
-        case Dir::northeast:
-            return { 1, -1 };
-        case Dir::east:
-            return { 1, 0 };
-        case Dir::southeast:
-            return { 1, 1 };
-        case Dir::south:
-            return { 0, 1 };
-        case Dir::southwest:
-            return { -1, 1 };
-        case Dir::west:
-            return { -1, 0 };
-        case Dir::northwest:
-            return { -1, -1 };
-        }
-        std::unreachable();
-    }
-
     std::vector<char> m_board;
     Vector2i m_size;
 };
 
-static int solve(const std::string& data)
+// Tells whether the 3x3 block whose rows start at above, center - 1 and below has an X-MAS around its center
+static bool is_x_mas(const char* above, const char* center, const char* below)
+{
+    const auto mas = [](const char first, const char second) {
+        return (first == 'M' && second == 'S') || (first == 'S' && second == 'M');
+    };
+    return *center == 'A' && mas(above[0], below[2]) && mas(above[2], below[0]);
+}
+
+#if defined(__AVX2__)
+constexpr int x_mas_lanes = 32;
+
+// Bit i is set if is_x_mas(above + i, center + i, below + i)
+static uint32_t x_mas_mask(const char* above, const char* center, const char* below)
+{
+    const auto load = [](const char* ptr) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr)); };
+    const auto equals = [](const __m256i block, const char c) { return _mm256_cmpeq_epi8(block, _mm256_set1_epi8(c)); };
+    const auto mas = [&](const __m256i first, const __m256i second) {
+        return _mm256_or_si256(
+            _mm256_and_si256(equals(first, 'M'), equals(second, 'S')),
+            _mm256_and_si256(equals(first, 'S'), equals(second, 'M')));
+    };
+    const __m256i above_left = load(above);
+    const __m256i above_right = load(above + 2);
+    const __m256i below_left = load(below);
+    const __m256i below_right = load(below + 2);
+    const __m256i result = _mm256_and_si256(
+        equals(load(center), 'A'), _mm256_and_si256(mas(above_left, below_right), mas(above_right, below_left)));
+    return static_cast<uint32_t>(_mm256_movemask_epi8(result));
+}
+#elif defined(__SSE2__) || defined(_M_X64)
+constexpr int x_mas_lanes = 16;
+
+// Bit i is set if is_x_mas(above + i, center + i, below + i)
+static uint32_t x_mas_mask(const char* above, const char* center, const char* below)
+{
+    const auto load = [](const char* ptr) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr)); };
+    const auto equals = [](const __m128i block, const char c) { return _mm_cmpeq_epi8(block, _mm_set1_epi8(c)); };
+    const auto mas = [&](const __m128i first, const __m128i second) {
+        return _mm_or_si128(
+            _mm_and_si128(equals(first, 'M'), equals(second, 'S')),
+            _mm_and_si128(equals(first, 'S'), equals(second, 'M')));
+    };
+    const __m128i above_left = load(above);
+    const __m128i above_right = load(above + 2);
+    const __m128i below_left = load(below);
+    const __m128i below_right = load(below + 2);
+    const __m128i result = _mm_and_si128(
+        equals(load(center), 'A'), _mm_and_si128(mas(above_left, below_right), mas(above_right, below_left)));
+    return static_cast<uint32_t>(_mm_movemask_epi8(result));
+}
+#else
+constexpr int x_mas_lanes = 1;
+
+static uint32_t x_mas_mask(const char* above, const char* center, const char* below)
+{
+    return is_x_mas(above, center, below) ? 1 : 0;
+}
+#endif
+
+// Counts X-MAS centers in rows [y_begin, y_end), which must not include the first or last row
+static int64_t x_mas_count(const WordSearch& search, const int y_begin, const int y_end)
+{
+    const int width = search.size().x;
+    int64_t count = 0;
+    for (int y = y_begin; y < y_end; ++y) {
+        // Shifted one left so that lane i covers the center at column i + 1
+        const char* above = search.row(y - 1).data();
+        const char* center = search.row(y).data() + 1;
+        const char* below = search.row(y + 1).data();
+        int x = 0;
+        for (; x + x_mas_lanes + 2 <= width; x += x_mas_lanes) {
+            count += std::popcount(x_mas_mask(above + x, center + x, below + x));
+        }
+        for (; x + 2 < width; ++x) {
+            count += is_x_mas(above + x, center + x, below + x) ? 1 : 0;
+        }
+    }
+    return count;
+}
+
+static int64_t solve(const std::string& data)
 {
     const WordSearch search = WordSearch::parse(data);
     const auto [width, height] = search.size();
-    int count = 0;
-    for (int y = 0; y < height; ++y) {
-        for (int x = 0; x < width; ++x) {
-            const bool first = search.word_at("MAS", { x, y }, WordSearch::Dir::southeast)
-                || search.word_at("SAM", { x, y }, WordSearch::Dir::southeast);
-            if (!first) {
-                continue;
-            }
-            const bool second = search.word_at("MAS", { x, y + 2 }, WordSearch::Dir::northeast)
-                || search.word_at("SAM", { x, y + 2 }, WordSearch::Dir::northeast);
-            if (second) {
-                ++count;
-            }
+    if (height < 3) {
+        return 0;
+    }
+    // Below this many cells per thread a band is not worth a thread
+    constexpr int64_t min_band_cells = 1 << 22;
+    const int n_bands = static_cast<int>(std::clamp<int64_t>(
+        static_cast<int64_t>(width) * height / min_band_cells,
+        1,
+        std::min(std::max(std::thread::hardware_concurrency(), 1u), static_cast<unsigned>(height - 2))));
+    if (n_bands == 1) {
+        return x_mas_count(search, 1, height - 1);
+    }
+    std::vector<int64_t> counts(n_bands, 0);
+    {
+        std::vector<std::jthread> workers;
+        workers.reserve(n_bands);
+        const int band_height = (height - 2) / n_bands;
+        for (int i = 0; i < n_bands; ++i) {
+            const int y_begin = 1 + i * band_height;
+            const int y_end = i == n_bands - 1 ? height - 1 : y_begin + band_height;
+            workers.emplace_back([&search, &counts, i, y_begin, y_end] {
+                counts[i] = x_mas_count(search, y_begin, y_end);
+            });
         }
     }
-    return count;
+    int64_t total = 0;
+    for (const int64_t count : counts) {
+        total += count;
+    }
+    return total;
 }
 
 int main()
@@ -154,12 +202,13 @@ int main()
         // ReSharper disable once CppDFAUnusedValue
         // ReSharper disable once CppDFAUnreadVariable
         // ReSharper disable once CppDeclaratorNeverUsed
-        volatile int result = solve(data);
+        volatile int64_t result = solve(data);
         auto end = std::chrono::high_resolution_clock::now();
         time_running_total += std::chrono::duration<double, std::nano>(end - start).count();
     }
     std::printf("Average ns: %d\n", static_cast<int>(std::round(time_running_total / n_runs)));
+
 #else
-    std::printf("%d\n", solve(data));
+    std::printf("%lld\n", solve(data));
 #endif
 }
\ No newline at end of file
@@ -1,11 +1,18 @@
 #include <algorithm>
+#include <array>
+#include <bitset>
+#include <cassert>
 #include <chrono>
 #include <cmath>
+#include <cstdio>
+#include <cstdlib>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <optional>
+#include <random>
 #include <sstream>
-#include <unordered_map>
+#include <string>
 #include <vector>
 #include <utility>
 
@@ -35,25 +42,62 @@ static std::optional<int> parse_int_opt(const std::string& string, int& pos)
     return result;
 }
 
-std::unordered_map<int, std::vector<int>> parse_rules(const std::string& data, int& pos)
+// Pages are two digit numbers so every rule fits a 100x100 bit matrix
+constexpr int max_pages = 100;
+
+using PageSet = std::bitset<max_pages>;
+
+// Pages index the rule matrix directly, so one out of range is rejected here instead of being written out of bounds
+static std::optional<int> parse_page_opt(const std::string& string, int& pos)
+{
+    const std::optional<int> page = parse_int_opt(string, pos);
+    if (page.has_value() && page.value() >= max_pages) {
+        std::fprintf(stderr, "Page %d out of range, pages must be below %d\n", page.value(), max_pages);
+        std::exit(EXIT_FAILURE);
+    }
+    return page;
+}
+
+class PageRules {
+public:
+    void add(const int before, const int after)
+    {
+        assert(before >= 0 && before < max_pages && after >= 0 && after < max_pages);
+        m_pages_after[before].set(after);
+    }
+
+    void remove(const int before, const int after)
+    {
+        m_pages_after[before].reset(after);
+    }
+
+    [[nodiscard]] bool before(const int page, const int other) const
+    {
+        return m_pages_after[page].test(other);
+    }
+
+    // Pages that a rule requires to come after page
+    [[nodiscard]] const PageSet& pages_after(const int page) const
+    {
+        return m_pages_after[page];
+    }
+
+private:
+    std::array<PageSet, max_pages> m_pages_after {};
+};
+
+static PageRules parse_rules(const std::string& data, int& pos)
 {
-    std::unordered_map<int, std::vector<int>> rules;
+    PageRules rules;
     while (true) {
-        std::optional<int> page1 = parse_int_opt(data, pos);
+        std::optional<int> page1 = parse_page_opt(data, pos);
         if (!page1.has_value()) {
             return rules;
         }
         ++pos; // |
-        std::optional<int> page2 = parse_int_opt(data, pos);
+        std::optional<int> page2 = parse_page_opt(data, pos);
         ++pos; // \n
-        if (auto it = rules.find(page1.value()); it != rules.end()) {
-            it->second.push_back(page2.value());
-        }
-        else {
-            std::vector<int> v;
-            v.push_back(page2.value());
-            rules[page1.value()] = std::move(v);
-        }
+        rules.add(page1.value(), page2.value());
     }
 }
 
@@ -62,7 +106,7 @@ const std::vector<int>& parse_update(const std::string& data, int& pos)
     static std::vector<int> update;
     update.clear();
     while (true) {
-        std::optional<int> page = parse_int_opt(data, pos);
+        std::optional<int> page = parse_page_opt(data, pos);
         update.push_back(page.value());
         if (data[pos] == '\n') {
             ++pos; // \n
@@ -72,64 +116,162 @@ const std::vector<int>& parse_update(const std::string& data, int& pos)
     }
 }
 
-static bool update_valid(const std::unordered_map<int, std::vector<int>>& rules, const std::vector<int>& update)
+// Every page must have a rule placing it before all of the pages that follow it, one AND per page
+static bool update_valid(const PageRules& rules, const std::vector<int>& update)
 {
-    for (int i = 0; i < update.size() - 1; ++i) {
-        const int page = update[i];
-        auto it = rules.find(page);
-        if (it == rules.end()) {
+    PageSet later_pages;
+    for (int i = static_cast<int>(update.size()) - 1; i >= 0; --i) {
+        if ((later_pages & ~rules.pages_after(update[i])).any()) {
             return false;
         }
-        const std::vector<int>& after = it->second;
-        for (int j = i + 1; j < update.size(); ++j) {
-            if (std::ranges::find(after, update[j]) == after.end()) {
-                return false;
-            }
-        }
+        later_pages.set(update[i]);
     }
     return true;
 }
 
-static int fixed_update_middle(const std::unordered_map<int, std::vector<int>>& rules, const std::vector<int>& update)
+// A page's position in the fixed order is the number of pages in the update that it must come before, one popcount
+// per page. Empty if the rules don't order the update's pages completely.
+static std::optional<int> fixed_update_middle(const PageRules& rules, const std::vector<int>& update)
 {
+    PageSet pages;
+    for (const int page : update) {
+        pages.set(page);
+    }
     const size_t target_index = update.size() / 2;
-    for (int i = 0; i < update.size(); ++i) {
-        int count = 0;
-        for (int j = 0; j < update.size(); ++j) {
-            if (i == j) {
-                continue;
-            }
-            if (auto it = rules.find(update[i]); it != rules.end()) {
-                if (const std::vector<int>& after = rules.at(update[i]);
-                    std::ranges::find(after, update[j]) != after.end()) {
-                    ++count;
-                    if (count > target_index) {
-                        break;
-                    }
+    for (const int page : update) {
+        if ((rules.pages_after(page) & pages).count() == target_index) {
+            return page;
+        }
+    }
+    return std::nullopt;
+}
+
+static int update_contribution(const PageRules& rules, const std::vector<int>& update)
+{
+    return update_valid(rules, update) ? 0 : fixed_update_middle(rules, update).value_or(0);
+}
+
+// Keeps the parsed updates with an index from each pair of pages to the updates containing both, so a rule change
+// only re-validates the updates it can affect and adjusts the running total
+class IncrementalOrdering {
+public:
+    static IncrementalOrdering parse(const std::string& data)
+    {
+        int pos = 0;
+        PageRules rules = parse_rules(data, pos);
+        ++pos; // \n
+        std::vector<std::vector<int>> updates;
+        while (pos < data.length()) {
+            updates.push_back(parse_update(data, pos));
+        }
+        return IncrementalOrdering { std::move(rules), std::move(updates) };
+    }
+
+    void add_rule(const int before, const int after)
+    {
+        if (!m_rules.before(before, after)) {
+            m_rules.add(before, after);
+            refresh_pair(before, after);
+        }
+    }
+
+    void remove_rule(const int before, const int after)
+    {
+        if (m_rules.before(before, after)) {
+            m_rules.remove(before, after);
+            refresh_pair(before, after);
+        }
+    }
+
+    [[nodiscard]] int total() const
+    {
+        return m_total;
+    }
+
+private:
+    IncrementalOrdering(PageRules rules, std::vector<std::vector<int>> updates)
+        : m_rules { std::move(rules) }
+        , m_updates { std::move(updates) }
+        , m_pair_updates(max_pages * max_pages)
+        , m_contributions(m_updates.size(), 0)
+    {
+        for (int i = 0; i < m_updates.size(); ++i) {
+            const std::vector<int>& update = m_updates[i];
+            for (int a = 0; a < update.size(); ++a) {
+                for (int b = a + 1; b < update.size(); ++b) {
+                    m_pair_updates[pair_index(update[a], update[b])].push_back(i);
                 }
             }
+            refresh(i);
         }
-        if (count == target_index) {
-            return update[i];
+    }
+
+    static int pair_index(const int page, const int other)
+    {
+        return std::min(page, other) * max_pages + std::max(page, other);
+    }
+
+    void refresh_pair(const int page, const int other)
+    {
+        for (const int i : m_pair_updates[pair_index(page, other)]) {
+            refresh(i);
         }
     }
-    std::unreachable();
-}
+
+    void refresh(const int i)
+    {
+        m_total -= m_contributions[i];
+        m_contributions[i] = update_contribution(m_rules, m_updates[i]);
+        m_total += m_contributions[i];
+    }
+
+    PageRules m_rules;
+    std::vector<std::vector<int>> m_updates;
+    std::vector<std::vector<int>> m_pair_updates;
+    std::vector<int> m_contributions;
+    int m_total = 0;
+};
 
 static int solve(const std::string& data)
 {
     int pos = 0;
-    const std::unordered_map<int, std::vector<int>> rules = parse_rules(data, pos);
+    const PageRules rules = parse_rules(data, pos);
     ++pos; // \n
     int result = 0;
     while (pos < data.length()) {
         if (const std::vector<int>& update = parse_update(data, pos); !update_valid(rules, update)) {
-            result += fixed_update_middle(rules, update);
+            result += fixed_update_middle(rules, update).value();
         }
     }
     return result;
 }
 
+#ifdef BENCHMARK
+// Previous quadratic version, kept for comparison
+static int fixed_update_middle_nested(const PageRules& rules, const std::vector<int>& update)
+{
+    const size_t target_index = update.size() / 2;
+    for (int i = 0; i < update.size(); ++i) {
+        int count = 0;
+        for (int j = 0; j < update.size(); ++j) {
+            if (i == j) {
+                continue;
+            }
+            if (rules.before(update[i], update[j])) {
+                ++count;
+                if (count > target_index) {
+                    break;
+                }
+            }
+        }
+        if (count == target_index) {
+            return update[i];
+        }
+    }
+    std::unreachable();
+}
+#endif
+
 int main()
 {
     const std::string data = read_data("./day05-part2/input.txt");
@@ -148,6 +290,104 @@ int main()
         time_running_total += std::chrono::duration<double, std::nano>(end - start).count();
     }
     std::printf("Average ns: %d\n", static_cast<int>(std::round(time_running_total / n_runs)));
+
+    // Long updates under a random total order of all pages, comparing rank counting with the nested loop
+    std::mt19937 rng { 2024 };
+    std::vector<int> order(max_pages);
+    for (int i = 0; i < max_pages; ++i) {
+        order[i] = i;
+    }
+    std::ranges::shuffle(order, rng);
+    PageRules rules;
+    for (int i = 0; i < max_pages; ++i) {
+        for (int j = i + 1; j < max_pages; ++j) {
+            rules.add(order[i], order[j]);
+        }
+    }
+    constexpr int n_updates = 100000;
+    constexpr int update_size = 99;
+    std::vector<std::vector<int>> updates;
+    updates.reserve(n_updates);
+    for (int i = 0; i < n_updates; ++i) {
+        std::ranges::shuffle(order, rng);
+        updates.emplace_back(order.begin(), order.begin() + update_size);
+    }
+    const auto time_per_update = [&](const auto& fixed_middle) {
+        auto start = std::chrono::high_resolution_clock::now();
+        int total = 0;
+        for (const std::vector<int>& update : updates) {
+            total += fixed_middle(rules, update);
+        }
+        // ReSharper disable once CppDFAUnusedValue
+        // ReSharper disable once CppDFAUnreadVariable
+        // ReSharper disable once CppDeclaratorNeverUsed
+        volatile int result = total;
+        auto end = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration<double, std::nano>(end - start).count() / n_updates;
+    };
+    std::printf(
+        "Average ns per %d page update (rank counting): %.2f\n",
+        update_size,
+        time_per_update([](const PageRules& page_rules, const std::vector<int>& update) {
+            return fixed_update_middle(page_rules, update).value();
+        }));
+    std::printf(
+        "Average ns per %d page update (nested loop): %.2f\n", update_size, time_per_update(fixed_update_middle_nested));
+
+    // Removing and restoring each rule in turn, incrementally and by re-solving from scratch
+    {
+        int rules_pos = 0;
+        const PageRules full_rules = parse_rules(data, rules_pos);
+        ++rules_pos; // \n
+        std::vector<std::vector<int>> all_updates;
+        while (rules_pos < data.length()) {
+            all_updates.push_back(parse_update(data, rules_pos));
+        }
+        std::vector<std::pair<int, int>> rule_pairs;
+        for (int page = 0; page < max_pages; ++page) {
+            for (int other = 0; other < max_pages; ++other) {
+                if (full_rules.before(page, other)) {
+                    rule_pairs.emplace_back(page, other);
+                }
+            }
+        }
+        IncrementalOrdering ordering = IncrementalOrdering::parse(data);
+        PageRules changed_rules = full_rules;
+        double time_incremental_total = 0.0;
+        double time_full_total = 0.0;
+        for (const auto& [before, after] : rule_pairs) {
+            auto start = std::chrono::high_resolution_clock::now();
+            ordering.remove_rule(before, after);
+            const int incremental_result = ordering.total();
+            ordering.add_rule(before, after);
+            auto middle = std::chrono::high_resolution_clock::now();
+            changed_rules.remove(before, after);
+            int full_result = 0;
+            for (const std::vector<int>& update : all_updates) {
+                full_result += update_contribution(changed_rules, update);
+            }
+            changed_rules.add(before, after);
+            auto end = std::chrono::high_resolution_clock::now();
+            if (incremental_result != full_result) {
+                std::fprintf(
+                    stderr,
+                    "Rule %d|%d removed: incremental total %d, full total %d\n",
+                    before,
+                    after,
+                    incremental_result,
+                    full_result);
+                return 1;
+            }
+            time_incremental_total += std::chrono::duration<double, std::nano>(middle - start).count();
+            time_full_total += std::chrono::duration<double, std::nano>(end - middle).count();
+        }
+        std::printf(
+            "Average ns per rule removed and restored (incremental): %d\n",
+            static_cast<int>(std::round(time_incremental_total / rule_pairs.size())));
+        std::printf(
+            "Average ns per rule removed and restored (from scratch): %d\n",
+            static_cast<int>(std::round(time_full_total / rule_pairs.size())));
+    }
 #else
     std::printf("%d\n", solve(data));
 #endif
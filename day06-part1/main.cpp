@@ -5,7 +5,10 @@
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <optional>
+#include <span>
 #include <sstream>
+#include <string>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -37,6 +40,7 @@ public:
         std::optional<int> width;
         std::optional<int> guard_index;
         std::vector<GridSquare> grid;
+        std::vector<int> obstacle_indices;
         int pos = 0;
         while (pos < string.length()) {
             while (string[pos] != '\n') {
@@ -44,6 +48,7 @@ public:
                     grid.push_back({ .obstacle = false, .visited = false });
                 }
                 else if (string[pos] == '#') {
+                    obstacle_indices.push_back(static_cast<int>(grid.size()));
                     grid.push_back({ .obstacle = true, .visited = false });
                 }
                 else if (string[pos] == '^') {
@@ -62,7 +67,7 @@ public:
         }
         assert(guard_index.has_value()); // Map must contain guard
         const Vector2i guard_pos = { guard_index.value() % width.value(), guard_index.value() / width.value() };
-        return Map { width.value(), std::move(grid), guard_pos };
+        return Map { width.value(), std::move(grid), obstacle_indices, guard_pos };
     }
 
     int move_and_count_visited()
@@ -90,32 +95,83 @@ private:
 
     enum class Dir { north, east, south, west };
 
-    static Vector2i dir_offset(const Dir dir)
-    {
-        switch (dir) {
-        case Dir::north:
-            return { 0, -1 };
-        case Dir::east:
-            return { 1, 0 };
-        case Dir::south:
-            return { 0, 1 };
-        case Dir::west:
-            return { -1, 0 };
-        }
-        std::unreachable();
-    }
-
-    Map(const int width, std::vector<GridSquare> grid, const Vector2i& guard_pos)
+    Map(const int width, std::vector<GridSquare> grid, const std::vector<int>& obstacle_indices,
+        const Vector2i& guard_pos)
         : m_grid { std::move(grid) }
         , m_size { width, static_cast<int>(m_grid.size()) / width }
         , m_guard_pos { guard_pos }
         , m_guard_dir { Dir::north }
     {
+        build_line_obstacles(obstacle_indices);
+    }
+
+    // Obstacle coordinates along each row and along each column in increasing order, so the next obstacle in any
+    // direction is one binary search away
+    struct LineObstacles {
+        std::vector<int> offsets; // Line i has coords[offsets[i]] to coords[offsets[i + 1]]
+        std::vector<int> coords;
+
+        [[nodiscard]] std::span<const int> line(const int i) const
+        {
+            return { coords.data() + offsets[i], coords.data() + offsets[i + 1] };
+        }
+    };
+
+    // Obstacle indices come in row major order so every line comes out sorted
+    void build_line_obstacles(const std::vector<int>& obstacle_indices)
+    {
+        m_row_obstacles.offsets.assign(m_size.y + 1, 0);
+        m_col_obstacles.offsets.assign(m_size.x + 1, 0);
+        for (const int i : obstacle_indices) {
+            ++m_row_obstacles.offsets[i / m_size.x + 1];
+            ++m_col_obstacles.offsets[i % m_size.x + 1];
+        }
+        for (LineObstacles* lines : { &m_row_obstacles, &m_col_obstacles }) {
+            for (int i = 1; i < lines->offsets.size(); ++i) {
+                lines->offsets[i] += lines->offsets[i - 1];
+            }
+            lines->coords.resize(lines->offsets.back());
+        }
+        std::vector<int> row_ends(m_row_obstacles.offsets.begin(), m_row_obstacles.offsets.end() - 1);
+        std::vector<int> col_ends(m_col_obstacles.offsets.begin(), m_col_obstacles.offsets.end() - 1);
+        for (const int i : obstacle_indices) {
+            const int x = i % m_size.x;
+            const int y = i / m_size.x;
+            m_row_obstacles.coords[row_ends[y]++] = x;
+            m_col_obstacles.coords[col_ends[x]++] = y;
+        }
     }
 
-    [[nodiscard]] bool in_bounds(const Vector2i& pos) const
+    // Where the guard stops moving straight from pos in dir and whether that is because it leaves the map
+    [[nodiscard]] std::pair<Vector2i, bool> jump(const Vector2i& pos, const Dir dir) const
     {
-        return pos.x >= 0 && pos.x < m_size.x && pos.y >= 0 && pos.y < m_size.y;
+        switch (dir) {
+        case Dir::north: {
+            const std::span<const int> col = m_col_obstacles.line(pos.x);
+            const auto it = std::ranges::lower_bound(col, pos.y);
+            return it == col.begin() ? std::pair { Vector2i { pos.x, 0 }, true }
+                                     : std::pair { Vector2i { pos.x, *(it - 1) + 1 }, false };
+        }
+        case Dir::south: {
+            const std::span<const int> col = m_col_obstacles.line(pos.x);
+            const auto it = std::ranges::upper_bound(col, pos.y);
+            return it == col.end() ? std::pair { Vector2i { pos.x, m_size.y - 1 }, true }
+                                   : std::pair { Vector2i { pos.x, *it - 1 }, false };
+        }
+        case Dir::west: {
+            const std::span<const int> row = m_row_obstacles.line(pos.y);
+            const auto it = std::ranges::lower_bound(row, pos.x);
+            return it == row.begin() ? std::pair { Vector2i { 0, pos.y }, true }
+                                     : std::pair { Vector2i { *(it - 1) + 1, pos.y }, false };
+        }
+        case Dir::east: {
+            const std::span<const int> row = m_row_obstacles.line(pos.y);
+            const auto it = std::ranges::upper_bound(row, pos.x);
+            return it == row.end() ? std::pair { Vector2i { m_size.x - 1, pos.y }, true }
+                                   : std::pair { Vector2i { *it - 1, pos.y }, false };
+        }
+        }
+        std::unreachable();
     }
 
     [[nodiscard]] int index(const Vector2i& pos) const
@@ -127,19 +183,20 @@ private:
 
     MoveResult move_until_stopped()
     {
-        const Vector2i move_offset = dir_offset(m_guard_dir);
-        Vector2i current = m_guard_pos;
-        while (true) {
-            current += move_offset;
-            if (!in_bounds(current)) {
-                return MoveResult::out_of_bounds;
-            }
-            auto& [obstacle, visited] = m_grid[index(current)];
-            if (obstacle) {
-                return MoveResult::obstacle;
-            }
-            visited = true;
-            m_guard_pos = current;
+        const auto [stop, exits] = jump(m_guard_pos, m_guard_dir);
+        paint_visited(m_guard_pos, stop);
+        m_guard_pos = stop;
+        return exits ? MoveResult::out_of_bounds : MoveResult::obstacle;
+    }
+
+    // Marks the straight line of cells from one position to another as visited
+    void paint_visited(const Vector2i& from, const Vector2i& to)
+    {
+        const int step = from.y == to.y ? 1 : m_size.x;
+        const int first = std::min(index(from), index(to));
+        const int last = std::max(index(from), index(to));
+        for (int i = first; i <= last; i += step) {
+            m_grid[i].visited = true;
         }
     }
 
@@ -163,6 +220,8 @@ private:
 
     std::vector<GridSquare> m_grid;
     Vector2i m_size;
+    LineObstacles m_row_obstacles;
+    LineObstacles m_col_obstacles;
     Vector2i m_guard_pos;
     Dir m_guard_dir;
 };
@@ -1,11 +1,17 @@
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <cassert>
 #include <chrono>
 #include <cmath>
+#include <cstdint>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <optional>
 #include <sstream>
+#include <string>
+#include <thread>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -29,11 +35,6 @@ struct Vector2i {
         return *this;
     }
 
-    Vector2i operator+(const Vector2i& other) const
-    {
-        return { x + other.x, y + other.y };
-    }
-
     bool operator!=(const Vector2i& other) const
     {
         return x != other.x || y != other.y;
@@ -46,18 +47,18 @@ public:
     {
         std::optional<int> width;
         std::optional<int> guard_index;
-        std::vector<GridSquare> grid;
+        std::vector<Cell> grid;
         int pos = 0;
         while (pos < string.length()) {
             while (string[pos] != '\n') {
                 if (string[pos] == '.') {
-                    grid.push_back({ .obstacle = false, .visited_dir = std::nullopt });
+                    grid.push_back(0);
                 }
                 else if (string[pos] == '#') {
-                    grid.push_back({ .obstacle = true, .visited_dir = std::nullopt });
+                    grid.push_back(obstacle_bit);
                 }
                 else if (string[pos] == '^') {
-                    grid.push_back({ .obstacle = false, .visited_dir = Dir::north });
+                    grid.push_back(dir_bit(Dir::north));
                     guard_index = static_cast<int>(grid.size()) - 1;
                 }
                 else {
@@ -77,56 +78,64 @@ public:
 
     int count_loops_with_new_obstacles()
     {
-        const std::vector<GridSquare> saved_grid = m_grid;
-        const Vector2i saved_guard_pos = m_guard_pos;
-        auto reset_state = [&] {
-            m_grid = saved_grid;
-            m_guard_pos = saved_guard_pos;
-            m_guard_dir = Dir::north;
-        };
-        const std::vector<Vector2i> visited = move_and_get_visited();
-        reset_state();
-        int count = 0;
-        for (const Vector2i& pos : visited) {
-            if (auto& [obstacle, visited] = m_grid[index(pos)]; !obstacle && m_guard_pos != pos) {
-                obstacle = true;
-                if (move_and_detect_loop()) {
-                    ++count;
-                }
-                obstacle = false;
-                reset_state();
-                m_grid[index(m_guard_pos)].visited_dir = Dir::north;
-            }
+        const std::vector<Candidate> candidates = walk_candidates();
+        // Each candidate only takes a few hundred guard turns, so below this many per worker a thread costs more than
+        // it saves
+        constexpr int min_worker_candidates = 1024;
+        const int n_workers = std::clamp(
+            static_cast<int>(candidates.size()) / min_worker_candidates,
+            1,
+            static_cast<int>(std::max(std::thread::hardware_concurrency(), 1u)));
+        if (n_workers == 1) {
+            return count_loops(candidates, 0, static_cast<int>(candidates.size()));
         }
-        return count;
-    }
-
-    std::vector<Vector2i> move_and_get_visited()
-    {
-        while (true) {
-            bool loop_detected;
-            if (const MoveResult result = move_until_stopped(loop_detected); result == MoveResult::out_of_bounds) {
-                break;
+        // Loop checks vary a lot in length so workers pull small batches instead of taking fixed ranges
+        constexpr int batch_size = 64;
+        std::atomic<int> next_batch { 0 };
+        std::atomic<int> total { 0 };
+        {
+            std::vector<std::jthread> workers;
+            workers.reserve(n_workers);
+            for (int i = 0; i < n_workers; ++i) {
+                workers.emplace_back([&] {
+                    int count = 0;
+                    TurnScratch scratch;
+                    int begin;
+                    while ((begin = next_batch.fetch_add(batch_size)) < candidates.size()) {
+                        const int end = std::min(begin + batch_size, static_cast<int>(candidates.size()));
+                        count += count_loops(candidates, begin, end, scratch);
+                    }
+                    total += count;
+                });
             }
-            rotate_guard();
         }
-        std::vector<Vector2i> visited;
-        for (int y = 0; y < m_size.y; ++y) {
-            for (int x = 0; x < m_size.x; ++x) {
-                if (m_grid[index({ x, y })].visited_dir.has_value()) {
-                    visited.push_back({ x, y });
-                }
-            }
-        }
-        return visited;
+        return total;
     }
 
 private:
     enum class Dir { north, east, south, west };
 
-    struct GridSquare {
-        bool obstacle;
-        std::optional<Dir> visited_dir;
+    // The low four bits of a cell are the directions the original path crossed it in, one per Dir, so a cell was
+    // visited when any of them is set
+    using Cell = uint8_t;
+    static constexpr Cell direction_bits = 0b1111;
+    static constexpr Cell obstacle_bit = 1 << 4;
+
+    static uint8_t dir_bit(const Dir dir)
+    {
+        return 1 << static_cast<int>(dir);
+    }
+
+    struct GuardState {
+        Vector2i pos;
+        Dir dir;
+    };
+
+    // A cell to try an obstacle on and the guard state at the start of the segment that first enters it. The path up
+    // to that state never touches the cell, so the loop check can resume there instead of at the start
+    struct Candidate {
+        Vector2i obstacle;
+        GuardState resume;
     };
 
     static Vector2i dir_offset(const Dir dir)
@@ -144,81 +153,195 @@ private:
         std::unreachable();
     }
 
-    Map(const int width, std::vector<GridSquare> grid, const Vector2i& guard_pos)
+    static Dir rotated(const Dir dir)
+    {
+        switch (dir) {
+        case Dir::north:
+            return Dir::east;
+        case Dir::east:
+            return Dir::south;
+        case Dir::south:
+            return Dir::west;
+        case Dir::west:
+            return Dir::north;
+        }
+        std::unreachable();
+    }
+
+    // Directions the guard turned in at each cell during one loop check, with the check's generation stored above the
+    // four direction bits. Entries from older generations count as empty, so the next check only bumps the generation
+    // and the turns are cleared once every time it wraps around
+    struct TurnScratch {
+        static constexpr int generation_shift = 4;
+        static constexpr uint16_t max_generation = UINT16_MAX >> generation_shift;
+        std::vector<uint16_t> turns;
+        uint16_t generation = 0;
+    };
+
+    Map(const int width, std::vector<Cell> grid, const Vector2i& guard_pos)
         : m_grid { std::move(grid) }
         , m_size { width, static_cast<int>(m_grid.size()) / width }
         , m_guard_pos { guard_pos }
         , m_guard_dir { Dir::north }
     {
+        build_stops();
     }
 
-    [[nodiscard]] bool in_bounds(const Vector2i& pos) const
+    // For each direction and cell, the row or column coordinate where the guard stops moving straight, filled in
+    // sweeps against the direction of movement so every cell copies its neighbour's answer
+    void build_stops()
     {
-        return pos.x >= 0 && pos.x < m_size.x && pos.y >= 0 && pos.y < m_size.y;
-    }
-
-    [[nodiscard]] int index(const Vector2i& pos) const
-    {
-        return pos.y * m_size.x + pos.x;
+        for (std::vector<int>& stops : m_stops) {
+            stops.resize(m_grid.size());
+        }
+        std::vector<int>& north = m_stops[static_cast<int>(Dir::north)];
+        std::vector<int>& west = m_stops[static_cast<int>(Dir::west)];
+        for (int y = 0; y < m_size.y; ++y) {
+            for (int x = 0; x < m_size.x; ++x) {
+                const int i = index({ x, y });
+                north[i] = y == 0 || (m_grid[i - m_size.x] & obstacle_bit) ? y : north[i - m_size.x];
+                west[i] = x == 0 || (m_grid[i - 1] & obstacle_bit) ? x : west[i - 1];
+            }
+        }
+        std::vector<int>& south = m_stops[static_cast<int>(Dir::south)];
+        std::vector<int>& east = m_stops[static_cast<int>(Dir::east)];
+        for (int y = m_size.y - 1; y >= 0; --y) {
+            for (int x = m_size.x - 1; x >= 0; --x) {
+                const int i = index({ x, y });
+                south[i] = y == m_size.y - 1 || (m_grid[i + m_size.x] & obstacle_bit) ? y : south[i + m_size.x];
+                east[i] = x == m_size.x - 1 || (m_grid[i + 1] & obstacle_bit) ? x : east[i + 1];
+            }
+        }
     }
 
-    enum class MoveResult { out_of_bounds, obstacle };
-
-    MoveResult move_until_stopped(bool& loop_detected)
+    // Walks the original path and returns each cell in the order the guard first enters it, excluding the start
+    std::vector<Candidate> walk_candidates()
     {
-        const Vector2i move_offset = dir_offset(m_guard_dir);
-        Vector2i current = m_guard_pos;
+        std::vector<Candidate> candidates;
         while (true) {
-            current += move_offset;
-            if (!in_bounds(current)) {
-                return MoveResult::out_of_bounds;
-            }
-            auto& [obstacle, visited] = m_grid[index(current)];
-            if (obstacle) {
-                return MoveResult::obstacle;
+            const GuardState segment_start { m_guard_pos, m_guard_dir };
+            const auto [stop, exits] = jump(m_guard_pos, m_guard_dir);
+            const Vector2i step = dir_offset(m_guard_dir);
+            for (Vector2i pos = m_guard_pos; pos != stop;) {
+                pos += step;
+                Cell& cell = m_grid[index(pos)];
+                if ((cell & direction_bits) == 0) {
+                    candidates.push_back({ .obstacle = pos, .resume = segment_start });
+                }
+                cell |= dir_bit(m_guard_dir);
             }
-            if (!loop_detected && visited == m_guard_dir) {
-                loop_detected = true;
+            m_guard_pos = stop;
+            if (exits) {
+                return candidates;
             }
-            visited = m_guard_dir;
-            m_guard_pos = current;
+            m_guard_dir = rotated(m_guard_dir);
         }
     }
 
-    bool move_and_detect_loop()
+    // Where the guard stops moving straight from pos in dir and whether that is because it leaves the map
+    [[nodiscard]] std::pair<Vector2i, bool> jump(const Vector2i& pos, const Dir dir) const
     {
-        while (true) {
-            bool loop_detected = false;
-            if (const MoveResult result = move_until_stopped(loop_detected); result == MoveResult::out_of_bounds) {
-                return false;
-            }
-            if (loop_detected) {
-                return true;
-            }
-            rotate_guard();
+        const int stop = m_stops[static_cast<int>(dir)][index(pos)];
+        switch (dir) {
+        case Dir::north:
+            return { { pos.x, stop }, stop == 0 };
+        case Dir::east:
+            return { { stop, pos.y }, stop == m_size.x - 1 };
+        case Dir::south:
+            return { { pos.x, stop }, stop == m_size.y - 1 };
+        case Dir::west:
+            return { { stop, pos.y }, stop == 0 };
         }
+        std::unreachable();
     }
 
-    void rotate_guard()
+    // Same as jump but with an extra obstacle, which only matters when it cuts the segment short
+    [[nodiscard]] std::pair<Vector2i, bool> jump(const Vector2i& pos, const Dir dir, const Vector2i& obstacle) const
     {
-        switch (m_guard_dir) {
+        const auto [stop, exits] = jump(pos, dir);
+        switch (dir) {
         case Dir::north:
-            m_guard_dir = Dir::east;
+            if (obstacle.x == pos.x && obstacle.y < pos.y && obstacle.y >= stop.y - 1) {
+                return { { pos.x, obstacle.y + 1 }, false };
+            }
             break;
         case Dir::east:
-            m_guard_dir = Dir::south;
+            if (obstacle.y == pos.y && obstacle.x > pos.x && obstacle.x <= stop.x + 1) {
+                return { { obstacle.x - 1, pos.y }, false };
+            }
             break;
         case Dir::south:
-            m_guard_dir = Dir::west;
+            if (obstacle.x == pos.x && obstacle.y > pos.y && obstacle.y <= stop.y + 1) {
+                return { { pos.x, obstacle.y - 1 }, false };
+            }
             break;
         case Dir::west:
-            m_guard_dir = Dir::north;
+            if (obstacle.y == pos.y && obstacle.x < pos.x && obstacle.x >= stop.x - 1) {
+                return { { obstacle.x + 1, pos.y }, false };
+            }
             break;
         }
+        return { stop, exits };
+    }
+
+    int count_loops(const std::vector<Candidate>& candidates, const int begin, const int end) const
+    {
+        TurnScratch scratch;
+        return count_loops(candidates, begin, end, scratch);
+    }
+
+    int count_loops(
+        const std::vector<Candidate>& candidates, const int begin, const int end, TurnScratch& scratch) const
+    {
+        if (scratch.turns.empty()) {
+            scratch.turns.resize(m_grid.size(), 0);
+        }
+        int count = 0;
+        for (int i = begin; i < end; ++i) {
+            if (loops_with_obstacle(candidates[i], scratch)) {
+                ++count;
+            }
+        }
+        return count;
+    }
+
+    // The guard is in a loop once it turns at the same cell in the same direction twice, so only turning points are
+    // recorded. Turns on the skipped prefix are not needed since a loop revisits its own turns
+    [[nodiscard]] bool loops_with_obstacle(const Candidate& candidate, TurnScratch& scratch) const
+    {
+        if (++scratch.generation > TurnScratch::max_generation) {
+            std::ranges::fill(scratch.turns, 0);
+            scratch.generation = 1;
+        }
+        const uint16_t stamp = scratch.generation << TurnScratch::generation_shift;
+        auto [pos, dir] = candidate.resume;
+        while (true) {
+            const auto [stop, exits] = jump(pos, dir, candidate.obstacle);
+            if (exits) {
+                return false;
+            }
+            const int i = index(stop);
+            uint16_t& turn = scratch.turns[i];
+            if ((turn & ~direction_bits) != stamp) {
+                turn = stamp;
+            }
+            else if (turn & dir_bit(dir)) {
+                return true;
+            }
+            turn |= dir_bit(dir);
+            pos = stop;
+            dir = rotated(dir);
+        }
+    }
+
+    [[nodiscard]] int index(const Vector2i& pos) const
+    {
+        return pos.y * m_size.x + pos.x;
     }
 
-    std::vector<GridSquare> m_grid;
+    std::vector<Cell> m_grid;
     Vector2i m_size;
+    std::array<std::vector<int>, 4> m_stops;
     Vector2i m_guard_pos;
     Dir m_guard_dir;
 };
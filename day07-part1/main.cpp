@@ -2,10 +2,14 @@
 #include <cassert>
 #include <chrono>
 #include <cmath>
+#include <cstdint>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <optional>
 #include <sstream>
+#include <string>
+#include <thread>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -18,45 +22,23 @@ static std::string read_data(const std::filesystem::path& path)
     return ss.str();
 }
 
-enum class Operator { add, mul };
-
-static std::optional<Operator> next_operator(const Operator op)
-{
-    switch (op) {
-    case Operator::add:
-        return Operator::mul;
-    case Operator::mul:
-        return std::nullopt;
-    }
-    std::unreachable();
-}
-
-static bool next_operators(std::vector<Operator>& ops)
-{
-    for (int i = 0; i < ops.size(); ++i) {
-        if (std::optional<Operator> next = next_operator(ops[i]); next.has_value()) {
-            ops[i] = next.value();
-            break;
-        }
-        ops[i] = Operator::add;
-        if (i == ops.size() - 1) {
-            return false;
-        }
-    }
-    return true;
-}
-
 static bool is_digit(const char c)
 {
     return c >= '0' && c <= '9';
 }
 
-static std::optional<int64_t> parse_int_opt(const std::string& string, int& pos)
+#ifdef __SIZEOF_INT128__
+using WideInt = __int128;
+#else
+using WideInt = int64_t;
+#endif
+
+static std::optional<WideInt> parse_int_opt(const std::string& string, size_t& pos)
 {
     if (!is_digit(string[pos])) {
         return std::nullopt;
     }
-    int64_t result = 0;
+    WideInt result = 0;
     do {
         result = result * 10 + (string[pos] - '0');
         ++pos;
@@ -64,12 +46,13 @@ static std::optional<int64_t> parse_int_opt(const std::string& string, int& pos)
     return result;
 }
 
+template <typename Int>
 struct Equation {
-    int64_t result {};
-    std::vector<int64_t> numbers;
+    Int result {};
+    std::vector<Int> numbers;
 };
 
-static void parse_equation(const std::string& data, int& pos, Equation& equation)
+static void parse_equation(const std::string& data, size_t& pos, Equation<WideInt>& equation)
 {
     equation.numbers.clear();
     equation.result = parse_int_opt(data, pos).value();
@@ -83,59 +66,122 @@ static void parse_equation(const std::string& data, int& pos, Equation& equation
     }
 }
 
-static bool evaluate_equals(const std::vector<int64_t>& numbers, const std::vector<Operator>& ops, const int64_t value)
+// The backward search never goes above the target, so a line is safe in 64 bits when its values are
+constexpr int64_t narrow_limit = INT64_MAX;
+
+// Copies the equation into 64 bit form if all of its values fit, so only lines that need it pay for wide arithmetic
+static bool narrow_equation(const Equation<WideInt>& equation, Equation<int64_t>& narrow)
 {
-    assert(!numbers.empty());
-    assert(ops.size() == numbers.size() - 1);
-    int64_t result = value;
-    for (int i = static_cast<int>(numbers.size()) - 1; i > 0; --i) {
-        const int64_t num = numbers[i];
-        switch (ops[i - 1]) {
-        case Operator::add:
-            result -= num;
-            if (result < 0) {
-                return false;
-            }
-            break;
-        case Operator::mul:
-            if (result % num != 0) {
-                return false;
-            }
-            result /= num;
-            break;
-        }
+    if (equation.result > narrow_limit
+        || std::ranges::any_of(equation.numbers, [](const WideInt num) { return num > narrow_limit; })) {
+        return false;
     }
-    return result == numbers[0];
+    narrow.result = static_cast<int64_t>(equation.result);
+    narrow.numbers.assign(equation.numbers.begin(), equation.numbers.end());
+    return true;
 }
 
-static bool validate_equation(const Equation& equation)
+// Undoes the operators from the last number back to the first. An operator can only have produced the target when it
+// passes divisibility or non-negative subtraction, so whole subtrees of operator choices are skipped at once and a
+// shared suffix of operators is never evaluated twice
+template <typename Int>
+static bool can_produce(const std::vector<Int>& numbers, const int count, const Int target)
 {
-    static std::vector<Operator> ops;
-    ops.clear();
-    ops.resize(equation.numbers.size() - 1, Operator::add);
-    do {
-        if (evaluate_equals(equation.numbers, ops, equation.result)) {
+    if (count == 1) {
+        return target == numbers[0];
+    }
+    const Int num = numbers[count - 1];
+    if (num == 0) {
+        // Anything times 0 is 0, whatever the numbers before it made
+        if (target == 0) {
             return true;
         }
-    } while (next_operators(ops));
-    return false;
+    }
+    else if (target % num == 0 && can_produce(numbers, count - 1, target / num)) {
+        return true;
+    }
+    return target >= num && can_produce(numbers, count - 1, target - num);
+}
+
+template <typename Int>
+static bool validate_equation(const Equation<Int>& equation)
+{
+    assert(!equation.numbers.empty());
+    return can_produce(equation.numbers, static_cast<int>(equation.numbers.size()), equation.result);
 }
 
-static int64_t solve(const std::string& data)
+// Sums the results of the valid equations on the lines starting in [begin, end)
+static WideInt calibration_total(const std::string& data, size_t begin, const size_t end)
 {
-    Equation equation;
-    int pos = 0;
-    int64_t result = 0;
-    while (pos < data.size()) {
+    if (begin != 0) {
+        const size_t line_end = data.find('\n', begin - 1);
+        if (line_end == std::string::npos) {
+            return 0;
+        }
+        begin = line_end + 1;
+    }
+    Equation<WideInt> equation;
+    Equation<int64_t> narrow;
+    WideInt result = 0;
+    size_t pos = begin;
+    while (pos < end) {
         parse_equation(data, pos, equation);
         ++pos; // \n
-        if (validate_equation(equation)) {
+        if (narrow_equation(equation, narrow) ? validate_equation(narrow) : validate_equation(equation)) {
             result += equation.result;
         }
     }
     return result;
 }
 
+static WideInt solve(const std::string& data)
+{
+    // Below this much input per thread the chunks are not worth a thread each
+    constexpr size_t min_chunk_size = 1 << 16;
+    const size_t n_chunks = std::clamp<size_t>(
+        data.length() / min_chunk_size, 1, std::max(std::thread::hardware_concurrency(), 1u));
+    if (n_chunks == 1) {
+        return calibration_total(data, 0, data.length());
+    }
+    std::vector<WideInt> totals(n_chunks);
+    {
+        std::vector<std::jthread> workers;
+        workers.reserve(n_chunks);
+        const size_t chunk_size = data.length() / n_chunks;
+        for (size_t i = 0; i < n_chunks; ++i) {
+            const size_t begin = i * chunk_size;
+            const size_t end = i == n_chunks - 1 ? data.length() : begin + chunk_size;
+            workers.emplace_back([&data, &totals, i, begin, end] { totals[i] = calibration_total(data, begin, end); });
+        }
+    }
+    WideInt total = 0;
+    for (const WideInt chunk_total : totals) {
+        total += chunk_total;
+    }
+    return total;
+}
+
+#ifndef BENCHMARK
+static std::string to_string(WideInt value)
+{
+    if (value == 0) {
+        return "0";
+    }
+    const bool negative = value < 0;
+    std::string string;
+    while (value != 0) {
+        const int digit = static_cast<int>(value % 10);
+        string.push_back(static_cast<char>('0' + (negative ? -digit : digit)));
+        value /= 10;
+    }
+    if (negative) {
+        string.push_back('-');
+    }
+    std::ranges::reverse(string);
+    return string;
+}
+#endif
+
 int main()
 {
     const std::string data = read_data("./day07-part1/input.txt");
@@ -149,12 +195,31 @@ int main()
         // ReSharper disable once CppDFAUnusedValue
         // ReSharper disable once CppDFAUnreadVariable
         // ReSharper disable once CppDeclaratorNeverUsed
-        volatile int64_t result = solve(data);
+        volatile WideInt result = solve(data);
         auto end = std::chrono::high_resolution_clock::now();
         time_running_total += std::chrono::duration<double, std::nano>(end - start).count();
     }
     std::printf("Average ns: %d\n", static_cast<int>(std::round(time_running_total / n_runs)));
+
+    // Operands of 0 on both the 64 bit and the wide path
+    for (const auto& [line, valid] : {
+        std::pair { "0: 0 0", true },
+        std::pair { "5: 5 0", true },
+        std::pair { "0: 7 0", true },
+        std::pair { "7: 7 0 3", false },
+        std::pair { "3: 7 0 3", true },
+        std::pair { "70: 7 0", false } }) {
+        const std::string line_data = std::string { line } + '\n';
+        size_t pos = 0;
+        Equation<WideInt> equation;
+        parse_equation(line_data, pos, equation);
+        if (Equation<int64_t> narrow; !narrow_equation(equation, narrow) || validate_equation(narrow) != valid
+            || validate_equation(equation) != valid) {
+            std::fprintf(stderr, "%s: expected %s\n", line, valid ? "valid" : "invalid");
+            return 1;
+        }
+    }
 #else
-    std::printf("%lld\n", solve(data));
+    std::printf("%s\n", to_string(solve(data)).c_str());
 #endif
 }
\ No newline at end of file
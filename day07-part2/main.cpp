@@ -3,10 +3,16 @@
 #include <cassert>
 #include <chrono>
 #include <cmath>
+#include <cstdint>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <optional>
+#include <random>
 #include <sstream>
+#include <string>
+#include <thread>
+#include <type_traits>
 #include <vector>
 
 static std::string read_data(const std::filesystem::path& path)
@@ -17,46 +23,23 @@ static std::string read_data(const std::filesystem::path& path)
     return ss.str();
 }
 
-enum class Operator { add, mul, concat };
-
-static std::optional<Operator> next_operator(const Operator op)
-{
-    switch (op) {
-    case Operator::add:
-        return Operator::mul;
-    case Operator::mul:
-        return Operator::concat;
-    default:
-        return std::nullopt;
-    }
-}
-
-static bool next_operators(std::vector<Operator>& ops)
-{
-    for (int i = 0; i < ops.size(); ++i) {
-        if (std::optional<Operator> next = next_operator(ops[i]); next.has_value()) {
-            ops[i] = next.value();
-            break;
-        }
-        ops[i] = Operator::add;
-        if (i == ops.size() - 1) {
-            return false;
-        }
-    }
-    return true;
-}
-
 static bool is_digit(const char c)
 {
     return c >= '0' && c <= '9';
 }
 
-static std::optional<int64_t> parse_int_opt(const std::string& string, int& pos)
+#ifdef __SIZEOF_INT128__
+using WideInt = __int128;
+#else
+using WideInt = int64_t;
+#endif
+
+static std::optional<WideInt> parse_int_opt(const std::string& string, size_t& pos)
 {
     if (!is_digit(string[pos])) {
         return std::nullopt;
     }
-    int64_t result = 0;
+    WideInt result = 0;
     do {
         result = result * 10 + (string[pos] - '0');
         ++pos;
@@ -64,18 +47,23 @@ static std::optional<int64_t> parse_int_opt(const std::string& string, int& pos)
     return result;
 }
 
+template <typename Int>
 struct Equation {
-    int64_t result {};
-    std::vector<int64_t> numbers;
+    Int result {};
+    std::vector<Int> numbers;
+    std::vector<int> digits; // Digit count of each number, so concatenation never has to measure it
 };
 
-static void parse_equation(const std::string& data, int& pos, Equation& equation)
+static void parse_equation(const std::string& data, size_t& pos, Equation<WideInt>& equation)
 {
     equation.numbers.clear();
+    equation.digits.clear();
     equation.result = parse_int_opt(data, pos).value();
     pos += 2; // :
     while (true) {
+        const size_t start = pos;
         equation.numbers.push_back(parse_int_opt(data, pos).value());
+        equation.digits.push_back(static_cast<int>(pos - start));
         if (data[pos] == '\n') {
             break;
         }
@@ -83,102 +71,207 @@ static void parse_equation(const std::string& data, int& pos, Equation& equation
     }
 }
 
-constexpr std::array pow10 {
-    1LL,
-    10LL,
-    100LL,
-    1000LL,
-    10000LL,
-    100000LL,
-    1000000LL,
-    10000000LL,
-    100000000LL,
-    1000000000LL,
-    10000000000LL,
-    100000000000LL,
-    1000000000000LL,
-    10000000000000LL,
-    100000000000000LL,
-    1000000000000000LL,
-    10000000000000000LL,
-    100000000000000000LL,
-    1000000000000000000LL,
-};
+constexpr std::array<int64_t, 19> pow10 = [] {
+    std::array<int64_t, 19> powers {};
+    int64_t power = 1;
+    for (size_t i = 0; i < powers.size(); ++i) {
+        powers[i] = power;
+        // 10^19 does not fit, so the last power is not multiplied past
+        if (i + 1 < powers.size()) {
+            power *= 10;
+        }
+    }
+    return powers;
+}();
+
+// From here on a number has more digits than there are powers of ten to split it off with
+constexpr int64_t narrow_limit = pow10.back();
 
-static int digits_count(const int64_t num)
+// Copies the equation into 64 bit form if all of its values fit, so only lines that need it pay for wide arithmetic
+static bool narrow_equation(const Equation<WideInt>& equation, Equation<int64_t>& narrow)
 {
-    int count = 1;
-    for (int i = 1; i < pow10.size(); ++i) {
-        if (num >= pow10[i]) {
-            ++count;
-        }
-        else {
-            break;
+    if (equation.result >= narrow_limit
+        || std::ranges::any_of(equation.numbers, [](const WideInt num) { return num >= narrow_limit; })
+        || std::ranges::any_of(equation.digits, [](const int digits) { return digits >= pow10.size(); })) {
+        return false;
+    }
+    narrow.result = static_cast<int64_t>(equation.result);
+    narrow.numbers.assign(equation.numbers.begin(), equation.numbers.end());
+    narrow.digits = equation.digits;
+    return true;
+}
+
+#ifdef __SIZEOF_INT128__
+// Multiply and shift that divides any non-negative int64_t by a power of ten exactly: with l = ceil(log2(divisor)) and
+// multiplier = ceil(2^(63 + l) / divisor), n / divisor == n * multiplier >> (63 + l) for every n below 2^63
+struct Reciprocal {
+    uint64_t multiplier;
+    int shift;
+};
+
+constexpr std::array<Reciprocal, pow10.size()> pow10_reciprocals = [] {
+    std::array<Reciprocal, pow10.size()> reciprocals {};
+    for (int i = 0; i < pow10.size(); ++i) {
+        const auto divisor = static_cast<unsigned __int128>(pow10[i]);
+        int l = 0;
+        while ((static_cast<unsigned __int128>(1) << l) < divisor) {
+            ++l;
         }
+        const unsigned __int128 numerator = static_cast<unsigned __int128>(1) << (63 + l);
+        reciprocals[i] = { static_cast<uint64_t>((numerator + divisor - 1) / divisor), 63 + l };
     }
-    return count;
+    return reciprocals;
+}();
+
+static int64_t divide_by_pow10(const int64_t num, const int exponent)
+{
+    const auto [multiplier, shift] = pow10_reciprocals[exponent];
+    return static_cast<int64_t>(static_cast<unsigned __int128>(num) * multiplier >> shift);
 }
+#else
+static int64_t divide_by_pow10(const int64_t num, const int exponent)
+{
+    return num / pow10[exponent];
+}
+#endif
 
-static bool evaluate_equals(const std::vector<int64_t>& numbers, const std::vector<Operator>& ops, const int64_t value)
+// Splits num off the end of target when target ends in its digits
+template <typename Int>
+static bool split_concat(const Int target, const Int num, const int digits, Int& prefix)
 {
-    assert(!numbers.empty());
-    assert(ops.size() == numbers.size() - 1);
-    int64_t result = value;
-    for (int i = static_cast<int>(numbers.size()) - 1; i > 0; --i) {
-        const int64_t num = numbers[i];
-        switch (ops[i - 1]) {
-        case Operator::add:
-            result -= num;
-            if (result < 0) {
-                return false;
-            }
-            break;
-        case Operator::mul:
-            if (result % num != 0) {
-                return false;
-            }
-            result /= num;
-            break;
-        case Operator::concat:
-            const int64_t divisor = pow10[digits_count(num)];
-            if (result % divisor != num) {
-                return false;
-            }
-            result /= divisor;
-            break;
+    if constexpr (std::is_same_v<Int, int64_t>) {
+        prefix = divide_by_pow10(target, digits);
+        return target - prefix * pow10[digits] == num;
+    }
+    else {
+        Int divisor = 1;
+        for (int i = 0; i < digits; ++i) {
+            divisor *= 10;
         }
+        prefix = target / divisor;
+        return target % divisor == num;
     }
-    return result == numbers[0];
 }
 
-static bool validate_equation(const Equation& equation)
+#ifdef BENCHMARK
+// Concatenation split as it was before digit counts were known up front, kept for comparison
+static bool split_concat_scanned(const int64_t target, const int64_t num, int64_t& prefix)
 {
-    static std::vector<Operator> ops;
-    ops.clear();
-    ops.resize(equation.numbers.size() - 1, Operator::add);
-    do {
-        if (evaluate_equals(equation.numbers, ops, equation.result)) {
+    int digits = 1;
+    while (digits < pow10.size() - 1 && num >= pow10[digits]) {
+        ++digits;
+    }
+    const int64_t divisor = pow10[digits];
+    prefix = target / divisor;
+    return target % divisor == num;
+}
+#endif
+
+// Undoes the operators from the last number back to the first. An operator can only have produced the target when it
+// passes divisibility, non-negative subtraction or a matching digit suffix, so whole subtrees of operator choices are
+// skipped at once and a shared suffix of operators is never evaluated twice
+template <typename Int>
+static bool can_produce(const Equation<Int>& equation, const int count, const Int target)
+{
+    if (count == 1) {
+        return target == equation.numbers[0];
+    }
+    const Int num = equation.numbers[count - 1];
+    if (Int prefix; split_concat(target, num, equation.digits[count - 1], prefix)
+        && can_produce(equation, count - 1, prefix)) {
+        return true;
+    }
+    if (num == 0) {
+        // Anything times 0 is 0, whatever the numbers before it made
+        if (target == 0) {
             return true;
         }
-    } while (next_operators(ops));
-    return false;
+    }
+    else if (target % num == 0 && can_produce(equation, count - 1, target / num)) {
+        return true;
+    }
+    return target >= num && can_produce(equation, count - 1, target - num);
 }
 
-static int64_t solve(const std::string& data)
+template <typename Int>
+static bool validate_equation(const Equation<Int>& equation)
 {
-    Equation equation;
-    int pos = 0;
-    int64_t result = 0;
-    while (pos < data.size()) {
+    assert(!equation.numbers.empty());
+    return can_produce(equation, static_cast<int>(equation.numbers.size()), equation.result);
+}
+
+// Sums the results of the valid equations on the lines starting in [begin, end)
+static WideInt calibration_total(const std::string& data, size_t begin, const size_t end)
+{
+    if (begin != 0) {
+        const size_t line_end = data.find('\n', begin - 1);
+        if (line_end == std::string::npos) {
+            return 0;
+        }
+        begin = line_end + 1;
+    }
+    Equation<WideInt> equation;
+    Equation<int64_t> narrow;
+    WideInt result = 0;
+    size_t pos = begin;
+    while (pos < end) {
         parse_equation(data, pos, equation);
         ++pos; // \n
-        if (validate_equation(equation)) {
+        if (narrow_equation(equation, narrow) ? validate_equation(narrow) : validate_equation(equation)) {
             result += equation.result;
         }
     }
     return result;
 }
 
+static WideInt solve(const std::string& data)
+{
+    // Below this much input per thread the chunks are not worth a thread each
+    constexpr size_t min_chunk_size = 1 << 16;
+    const size_t n_chunks = std::clamp<size_t>(
+        data.length() / min_chunk_size, 1, std::max(std::thread::hardware_concurrency(), 1u));
+    if (n_chunks == 1) {
+        return calibration_total(data, 0, data.length());
+    }
+    std::vector<WideInt> totals(n_chunks);
+    {
+        std::vector<std::jthread> workers;
+        workers.reserve(n_chunks);
+        const size_t chunk_size = data.length() / n_chunks;
+        for (size_t i = 0; i < n_chunks; ++i) {
+            const size_t begin = i * chunk_size;
+            const size_t end = i == n_chunks - 1 ? data.length() : begin + chunk_size;
+            workers.emplace_back([&data, &totals, i, begin, end] { totals[i] = calibration_total(data, begin, end); });
+        }
+    }
+    WideInt total = 0;
+    for (const WideInt chunk_total : totals) {
+        total += chunk_total;
+    }
+    return total;
+}
+
+#ifndef BENCHMARK
+static std::string to_string(WideInt value)
+{
+    if (value == 0) {
+        return "0";
+    }
+    const bool negative = value < 0;
+    std::string string;
+    while (value != 0) {
+        const int digit = static_cast<int>(value % 10);
+        string.push_back(static_cast<char>('0' + (negative ? -digit : digit)));
+        value /= 10;
+    }
+    if (negative) {
+        string.push_back('-');
+    }
+    std::ranges::reverse(string);
+    return string;
+}
+#endif
+
 int main()
 {
     const std::string data = read_data("./day07-part2/input.txt");
@@ -192,12 +285,79 @@ int main()
         // ReSharper disable once CppDFAUnusedValue
         // ReSharper disable once CppDFAUnreadVariable
         // ReSharper disable once CppDeclaratorNeverUsed
-        volatile int64_t result = solve(data);
+        volatile WideInt result = solve(data);
         auto end = std::chrono::high_resolution_clock::now();
         time_running_total += std::chrono::duration<double, std::nano>(end - start).count();
     }
     std::printf("Average ns: %d\n", static_cast<int>(std::round(time_running_total / n_runs)));
+
+    // Operands of 0 on both the 64 bit and the wide path
+    for (const auto& [line, valid] : {
+        std::pair { "0: 0 0", true },
+        std::pair { "5: 5 0", true },
+        std::pair { "0: 7 0", true },
+        std::pair { "7: 7 0 3", false },
+        std::pair { "3: 7 0 3", true },
+        std::pair { "70: 7 0", true },
+        std::pair { "703: 7 0 3", true } }) {
+        const std::string line_data = std::string { line } + '\n';
+        size_t pos = 0;
+        Equation<WideInt> equation;
+        parse_equation(line_data, pos, equation);
+        if (Equation<int64_t> narrow; !narrow_equation(equation, narrow) || validate_equation(narrow) != valid
+            || validate_equation(equation) != valid) {
+            std::fprintf(stderr, "%s: expected %s\n", line, valid ? "valid" : "invalid");
+            return 1;
+        }
+    }
+
+    // Concatenation splits on their own, half of them matching, with operands sized like the input's
+    std::mt19937 rng { 2024 };
+    std::uniform_int_distribution<int> digits_dist { 1, 3 };
+    std::uniform_int_distribution<int64_t> prefix_dist { 0, pow10[12] };
+    struct Split {
+        int64_t target;
+        int64_t num;
+        int digits;
+    };
+    constexpr int n_splits = 1 << 16;
+    std::vector<Split> splits;
+    splits.reserve(n_splits);
+    for (int i = 0; i < n_splits; ++i) {
+        const int digits = digits_dist(rng);
+        const int64_t num = std::uniform_int_distribution<int64_t> { pow10[digits - 1], pow10[digits] - 1 }(rng);
+        const int64_t target = prefix_dist(rng) * pow10[digits] + (i % 2 == 0 ? num : (num + 1) % pow10[digits]);
+        splits.push_back({ .target = target, .num = num, .digits = digits });
+    }
+    const auto time_per_split = [&](const auto& split_concat_fn) {
+        constexpr int n_split_runs = 100;
+        auto start = std::chrono::high_resolution_clock::now();
+        int64_t total = 0;
+        for (int n_run = 0; n_run < n_split_runs; ++n_run) {
+            for (const auto& [target, num, digits] : splits) {
+                if (int64_t prefix; split_concat_fn(target, num, digits, prefix)) {
+                    total += prefix;
+                }
+            }
+        }
+        // ReSharper disable once CppDFAUnusedValue
+        // ReSharper disable once CppDFAUnreadVariable
+        // ReSharper disable once CppDeclaratorNeverUsed
+        volatile int64_t result = total;
+        auto end = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration<double, std::nano>(end - start).count() / (n_split_runs * n_splits);
+    };
+    std::printf(
+        "Average ns per concat split (known digits, reciprocal multiply): %.2f\n",
+        time_per_split([](const int64_t target, const int64_t num, const int digits, int64_t& prefix) {
+            return split_concat(target, num, digits, prefix);
+        }));
+    std::printf(
+        "Average ns per concat split (scanned digits, runtime divisor): %.2f\n",
+        time_per_split([](const int64_t target, const int64_t num, int, int64_t& prefix) {
+            return split_concat_scanned(target, num, prefix);
+        }));
 #else
-    std::printf("%lld\n", solve(data));
+    std::printf("%s\n", to_string(solve(data)).c_str());
 #endif
 }
\ No newline at end of file
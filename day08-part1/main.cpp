@@ -1,15 +1,17 @@
 #include <algorithm>
 #include <array>
-#include <cassert>
+#include <atomic>
+#include <bit>
 #include <chrono>
 #include <cmath>
+#include <cstdint>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
-#include <ranges>
+#include <optional>
 #include <sstream>
-#include <unordered_map>
-#include <unordered_set>
+#include <string>
+#include <thread>
 #include <vector>
 
 static std::string read_data(const std::filesystem::path& path)
@@ -50,31 +52,66 @@ struct Vector2i {
     {
         return x != other.x || y != other.y;
     }
+};
+
+// One bit per map cell, rows padded to whole words
+class Bitgrid {
+public:
+    explicit Bitgrid(const Vector2i& size)
+        : m_row_words { (size.x + 63) / 64 }
+        , m_words(static_cast<size_t>(m_row_words) * size.y, 0)
+    {
+    }
 
-    bool operator<(const Vector2i& other) const
+    void set(const Vector2i& pos)
     {
-        if (x == other.x) {
-            return y < other.y;
+        m_words[pos.y * m_row_words + pos.x / 64] |= uint64_t { 1 } << (pos.x % 64);
+    }
+
+    void merge(const Bitgrid& other)
+    {
+        for (int i = 0; i < m_words.size(); ++i) {
+            m_words[i] |= other.m_words[i];
         }
-        return x < other.x;
     }
-};
 
-template <>
-struct std::hash<Vector2i> {
-    size_t operator()(const Vector2i& vector) const noexcept
+    [[nodiscard]] int64_t count() const
     {
-        const size_t hash1 = std::hash<int>()(vector.x);
-        const size_t hash2 = std::hash<int>()(vector.y);
-        return hash1 ^ hash2 << 1;
+        int64_t count = 0;
+        for (const uint64_t word : m_words) {
+            count += std::popcount(word);
+        }
+        return count;
     }
+
+private:
+    int m_row_words;
+    std::vector<uint64_t> m_words;
 };
 
+// Antenna frequencies are digits and upper and lower case letters
+constexpr int n_frequencies = 10 + 26 + 26;
+
+// Empty for anything that is not an antenna, such as '.' or a stray '\r', so parsing skips it
+static std::optional<int> frequency_index(const char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'A' && c <= 'Z') {
+        return 10 + (c - 'A');
+    }
+    if (c >= 'a' && c <= 'z') {
+        return 10 + 26 + (c - 'a');
+    }
+    return std::nullopt;
+}
+
 class Map {
 public:
     static Map parse(const std::string& data)
     {
-        std::unordered_map<char, std::vector<Vector2i>> antennas;
+        std::array<std::vector<Vector2i>, n_frequencies> antennas;
         std::optional<int> width;
         int y = 0;
         for (int i = 0; i < data.size(); ++i) {
@@ -86,66 +123,90 @@ public:
                 ++y;
                 continue;
             }
-            if (c != '.') {
+            if (const std::optional<int> frequency = frequency_index(c); frequency.has_value()) {
                 const int x = width.has_value() ? i % (width.value() + 1) : i;
-                if (auto it = antennas.find(c); it != antennas.end()) {
-                    it->second.push_back({ x, y });
-                }
-                else {
-                    std::vector<Vector2i> v;
-                    v.push_back({ x, y });
-                    antennas[c] = std::move(v);
-                }
+                antennas[frequency.value()].push_back({ x, y });
             }
         }
         Vector2i size { width.value(), y };
         return { std::move(antennas), size };
     }
 
-    [[nodiscard]] std::unordered_set<Vector2i> antinodes() const
+    [[nodiscard]] int64_t antinodes_count() const
     {
-        std::unordered_set<Vector2i> antinodes;
-        for (const auto& positions : m_antennas | std::views::values) {
-            for (int i = 0; i < positions.size(); ++i) {
-                for (int j = i + 1; j < positions.size(); ++j) {
-                    Vector2i a = positions[i];
-                    Vector2i b = positions[j];
-                    if (b < a) {
-                        std::swap(a, b);
-                    }
-                    const Vector2i diff = b - a;
-                    if (const Vector2i antinode1 = a - diff; in_bounds(antinode1)) {
-                        antinodes.insert(antinode1);
-                    }
-                    if (const Vector2i antinode2 = b + diff; in_bounds(antinode2)) {
-                        antinodes.insert(antinode2);
+        // Frequencies are independent, so with enough antenna pairs each worker marks its share of them in its own
+        // grid and the grids are OR-ed together at the end
+        constexpr int64_t min_worker_pairs = 1 << 16;
+        int64_t n_pairs = 0;
+        for (const std::vector<Vector2i>& positions : m_antennas) {
+            n_pairs += static_cast<int64_t>(positions.size()) * (static_cast<int64_t>(positions.size()) - 1) / 2;
+        }
+        const int n_workers = static_cast<int>(std::clamp<int64_t>(
+            n_pairs / min_worker_pairs, 1, std::max(std::thread::hardware_concurrency(), 1u)));
+        if (n_workers == 1) {
+            Bitgrid antinodes { m_size };
+            for (const std::vector<Vector2i>& positions : m_antennas) {
+                mark_antinodes(positions, antinodes);
+            }
+            return antinodes.count();
+        }
+        std::vector<Bitgrid> grids(n_workers, Bitgrid { m_size });
+        {
+            std::atomic<int> next_frequency { 0 };
+            std::vector<std::jthread> workers;
+            workers.reserve(n_workers);
+            for (int i = 0; i < n_workers; ++i) {
+                workers.emplace_back([this, &grids, &next_frequency, i] {
+                    int frequency;
+                    while ((frequency = next_frequency++) < n_frequencies) {
+                        mark_antinodes(m_antennas[frequency], grids[i]);
                     }
-                }
+                });
             }
         }
-        return antinodes;
+        for (int i = 1; i < n_workers; ++i) {
+            grids[0].merge(grids[i]);
+        }
+        return grids[0].count();
     }
 
 private:
-    Map(std::unordered_map<char, std::vector<Vector2i>>&& antennas, const Vector2i& size)
+    Map(std::array<std::vector<Vector2i>, n_frequencies>&& antennas, const Vector2i& size)
         : m_antennas { std::move(antennas) }
         , m_size { size }
     {
     }
 
+    void mark_antinodes(const std::vector<Vector2i>& positions, Bitgrid& antinodes) const
+    {
+        for (int i = 0; i < positions.size(); ++i) {
+            for (int j = i + 1; j < positions.size(); ++j) {
+                const Vector2i a = positions[i];
+                const Vector2i b = positions[j];
+                const Vector2i diff = b - a;
+                if (const Vector2i antinode1 = a - diff; in_bounds(antinode1)) {
+                    antinodes.set(antinode1);
+                }
+                if (const Vector2i antinode2 = b + diff; in_bounds(antinode2)) {
+                    antinodes.set(antinode2);
+                }
+            }
+        }
+    }
+
     [[nodiscard]] bool in_bounds(const Vector2i& pos) const
     {
         return pos.x >= 0 && pos.x < m_size.x && pos.y >= 0 && pos.y < m_size.y;
     }
 
-    std::unordered_map<char, std::vector<Vector2i>> m_antennas;
+    std::array<std::vector<Vector2i>, n_frequencies> m_antennas;
     Vector2i m_size {};
 };
 
 static int64_t solve(const std::string& data)
 {
     const Map map = Map::parse(data);
-    return static_cast<int64_t>(map.antinodes().size());
+    return map.antinodes_count();
 }
 
 int main()
@@ -1,15 +1,20 @@
 #include <algorithm>
 #include <array>
-#include <cassert>
+#include <atomic>
+#include <bit>
 #include <chrono>
 #include <cmath>
+#include <cstdint>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
-#include <ranges>
+#include <numeric>
+#include <optional>
+#include <random>
 #include <sstream>
-#include <unordered_map>
-#include <unordered_set>
+#include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
 static std::string read_data(const std::filesystem::path& path)
@@ -57,31 +62,78 @@ struct Vector2i {
     {
         return x != other.x || y != other.y;
     }
+};
+
+// One bit per map cell, rows padded to whole words
+class Bitgrid {
+public:
+    explicit Bitgrid(const Vector2i& size)
+        : m_width { size.x }
+        , m_row_words { (size.x + 63) / 64 }
+        , m_words(static_cast<size_t>(m_row_words) * size.y, 0)
+    {
+    }
 
-    bool operator<(const Vector2i& other) const
+    void set(const Vector2i& pos)
     {
-        if (x == other.x) {
-            return y < other.y;
+        m_words[pos.y * m_row_words + pos.x / 64] |= uint64_t { 1 } << (pos.x % 64);
+    }
+
+    // Sets the whole row a word at a time, leaving the padding clear
+    void fill_row(const int y)
+    {
+        uint64_t* row = m_words.data() + y * m_row_words;
+        std::fill(row, row + m_width / 64, ~uint64_t { 0 });
+        if (m_width % 64 != 0) {
+            row[m_width / 64] = (uint64_t { 1 } << (m_width % 64)) - 1;
         }
-        return x < other.x;
     }
-};
 
-template <>
-struct std::hash<Vector2i> {
-    size_t operator()(const Vector2i& vector) const noexcept
+    void merge(const Bitgrid& other)
     {
-        const size_t hash1 = std::hash<int>()(vector.x);
-        const size_t hash2 = std::hash<int>()(vector.y);
-        return hash1 ^ hash2 << 1;
+        for (int i = 0; i < m_words.size(); ++i) {
+            m_words[i] |= other.m_words[i];
+        }
     }
+
+    [[nodiscard]] int64_t count() const
+    {
+        int64_t count = 0;
+        for (const uint64_t word : m_words) {
+            count += std::popcount(word);
+        }
+        return count;
+    }
+
+private:
+    int m_width;
+    int m_row_words;
+    std::vector<uint64_t> m_words;
 };
 
+// Antenna frequencies are digits and upper and lower case letters
+constexpr int n_frequencies = 10 + 26 + 26;
+
+// Empty for anything that is not an antenna, such as '.' or a stray '\r', so parsing skips it
+static std::optional<int> frequency_index(const char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'A' && c <= 'Z') {
+        return 10 + (c - 'A');
+    }
+    if (c >= 'a' && c <= 'z') {
+        return 10 + 26 + (c - 'a');
+    }
+    return std::nullopt;
+}
+
 class Map {
 public:
     static Map parse(const std::string& data)
     {
-        std::unordered_map<char, std::vector<Vector2i>> antennas;
+        std::array<std::vector<Vector2i>, n_frequencies> antennas;
         std::optional<int> width;
         int y = 0;
         for (int i = 0; i < data.size(); ++i) {
@@ -93,70 +145,165 @@ public:
                 ++y;
                 continue;
             }
-            if (c != '.') {
+            if (const std::optional<int> frequency = frequency_index(c); frequency.has_value()) {
                 const int x = width.has_value() ? i % (width.value() + 1) : i;
-                if (auto it = antennas.find(c); it != antennas.end()) {
-                    it->second.push_back({ x, y });
-                }
-                else {
-                    std::vector<Vector2i> v;
-                    v.push_back({ x, y });
-                    antennas[c] = std::move(v);
-                }
+                antennas[frequency.value()].push_back({ x, y });
             }
         }
         Vector2i size { width.value(), y };
         return { std::move(antennas), size };
     }
 
-    [[nodiscard]] std::unordered_set<Vector2i> antinodes() const
+    [[nodiscard]] int64_t antinodes_count() const
     {
-        std::unordered_set<Vector2i> antinodes;
-        for (const auto& positions : m_antennas | std::views::values) {
-            for (int i = 0; i < positions.size(); ++i) {
-                for (int j = i + 1; j < positions.size(); ++j) {
-                    Vector2i a = positions[i];
-                    Vector2i b = positions[j];
-                    if (b < a) {
-                        std::swap(a, b);
+        // Frequencies are independent, so with enough antenna pairs each worker marks its share of them in its own
+        // grid and the grids are OR-ed together at the end
+        constexpr int64_t min_worker_pairs = 1 << 16;
+        int64_t n_pairs = 0;
+        for (const std::vector<Vector2i>& positions : m_antennas) {
+            n_pairs += static_cast<int64_t>(positions.size()) * (static_cast<int64_t>(positions.size()) - 1) / 2;
+        }
+        const int n_workers = static_cast<int>(std::clamp<int64_t>(
+            n_pairs / min_worker_pairs, 1, std::max(std::thread::hardware_concurrency(), 1u)));
+        if (n_workers == 1) {
+            Bitgrid antinodes { m_size };
+            for (const std::vector<Vector2i>& positions : m_antennas) {
+                mark_antinodes(positions, antinodes);
+            }
+            return antinodes.count();
+        }
+        std::vector<Bitgrid> grids(n_workers, Bitgrid { m_size });
+        {
+            std::atomic<int> next_frequency { 0 };
+            std::vector<std::jthread> workers;
+            workers.reserve(n_workers);
+            for (int i = 0; i < n_workers; ++i) {
+                workers.emplace_back([this, &grids, &next_frequency, i] {
+                    int frequency;
+                    while ((frequency = next_frequency++) < n_frequencies) {
+                        mark_antinodes(m_antennas[frequency], grids[i]);
                     }
-                    const Vector2i diff = b - a;
-                    Vector2i antinode = a;
-                    do {
-                        antinodes.insert(antinode);
-                        antinode -= diff;
-                    } while (in_bounds(antinode));
-                    antinode = b;
-                    do {
-                        antinodes.insert(antinode);
-                        antinode += diff;
-                    } while (in_bounds(antinode));
-                }
+                });
             }
         }
-        return antinodes;
+        for (int i = 1; i < n_workers; ++i) {
+            grids[0].merge(grids[i]);
+        }
+        return grids[0].count();
     }
 
 private:
-    Map(std::unordered_map<char, std::vector<Vector2i>>&& antennas, const Vector2i& size)
+    Map(std::array<std::vector<Vector2i>, n_frequencies>&& antennas, const Vector2i& size)
         : m_antennas { std::move(antennas) }
         , m_size { size }
     {
     }
 
-    [[nodiscard]] bool in_bounds(const Vector2i& pos) const
+    // Smallest integer step along diff, oriented so every line has exactly one direction
+    static Vector2i line_direction(const Vector2i& diff)
     {
-        return pos.x >= 0 && pos.x < m_size.x && pos.y >= 0 && pos.y < m_size.y;
+        const int divisor = std::gcd(diff.x, diff.y);
+        Vector2i dir { diff.x / divisor, diff.y / divisor };
+        if (dir.y < 0 || (dir.y == 0 && dir.x < 0)) {
+            dir = { -dir.x, -dir.y };
+        }
+        return dir;
+    }
+
+    static int64_t direction_key(const Vector2i& dir)
+    {
+        return static_cast<int64_t>(dir.y) << 32 | static_cast<uint32_t>(dir.x);
+    }
+
+    static Vector2i key_direction(const int64_t key)
+    {
+        return { static_cast<int32_t>(static_cast<uint32_t>(key)), static_cast<int>(key >> 32) };
     }
 
-    std::unordered_map<char, std::vector<Vector2i>> m_antennas;
+    // Range of k for which start + k * step stays in [0, size), step must not be zero
+    static std::pair<int, int> step_range(const int start, const int step, const int size)
+    {
+        if (step > 0) {
+            return { -(start / step), (size - 1 - start) / step };
+        }
+        return { -((size - 1 - start) / -step), start / -step };
+    }
+
+    // Each line through two or more antennas is drawn once, from the first antenna on it. From every antenna the
+    // directions to all the others are sorted, and a direction is skipped when an earlier antenna lies along it
+    void mark_antinodes(const std::vector<Vector2i>& positions, Bitgrid& antinodes) const
+    {
+        // Sorting only pays off once a frequency has enough antennas for collinear ones to be common
+        constexpr int min_dedup_antennas = 32;
+        if (positions.size() < min_dedup_antennas) {
+            for (int i = 0; i < positions.size(); ++i) {
+                for (int j = i + 1; j < positions.size(); ++j) {
+                    draw_line(positions[i], line_direction(positions[j] - positions[i]), antinodes);
+                }
+            }
+            return;
+        }
+        std::vector<int64_t> keys;
+        for (int i = 0; i < positions.size(); ++i) {
+            keys.clear();
+            for (int j = 0; j < positions.size(); ++j) {
+                if (j != i) {
+                    // Low bit is clear for earlier antennas so they sort first within a direction
+                    keys.push_back(direction_key(line_direction(positions[j] - positions[i])) * 2 + (j < i ? 0 : 1));
+                }
+            }
+            std::ranges::sort(keys);
+            for (int k = 0; k < keys.size(); ++k) {
+                if ((k == 0 || keys[k] >> 1 != keys[k - 1] >> 1) && (keys[k] & 1) == 1) {
+                    draw_line(positions[i], key_direction(keys[k] >> 1), antinodes);
+                }
+            }
+        }
+    }
+
+    void draw_line(const Vector2i& point, const Vector2i& dir, Bitgrid& antinodes) const
+    {
+        if (dir.y == 0) {
+            antinodes.fill_row(point.y);
+            return;
+        }
+        auto [first, last] = step_range(point.y, dir.y, m_size.y);
+        if (dir.x != 0) {
+            const auto [x_first, x_last] = step_range(point.x, dir.x, m_size.x);
+            first = std::max(first, x_first);
+            last = std::min(last, x_last);
+        }
+        for (int k = first; k <= last; ++k) {
+            antinodes.set({ point.x + k * dir.x, point.y + k * dir.y });
+        }
+    }
+
+#ifdef BENCHMARK
+public:
+    // Rasterizes the line of every pair separately, without sharing collinear lines, kept for comparison
+    [[nodiscard]] int64_t antinodes_count_per_pair() const
+    {
+        Bitgrid antinodes { m_size };
+        for (const std::vector<Vector2i>& positions : m_antennas) {
+            for (int i = 0; i < positions.size(); ++i) {
+                for (int j = i + 1; j < positions.size(); ++j) {
+                    draw_line(positions[i], line_direction(positions[j] - positions[i]), antinodes);
+                }
+            }
+        }
+        return antinodes.count();
+    }
+
+private:
+#endif
+    std::array<std::vector<Vector2i>, n_frequencies> m_antennas;
     Vector2i m_size {};
 };
 
 static int64_t solve(const std::string& data)
 {
     const Map map = Map::parse(data);
-    return static_cast<int64_t>(map.antinodes().size());
+    return map.antinodes_count();
 }
 
 int main()
@@ -177,6 +324,60 @@ int main()
         time_running_total += std::chrono::duration<double, std::nano>(end - start).count();
     }
     std::printf("Average ns: %d\n", static_cast<int>(std::round(time_running_total / n_runs)));
+
+    // Dense synthetic map with thousands of same frequency antennas on a coarse lattice, so many are collinear
+    {
+        constexpr int map_size = 1024;
+        constexpr int lattice_step = 16;
+        constexpr int n_antennas = 2000;
+        std::mt19937 rng { 2024 };
+        std::vector<Vector2i> lattice;
+        for (int y = 0; y < map_size; y += lattice_step) {
+            for (int x = 0; x < map_size; x += lattice_step) {
+                lattice.push_back({ x, y });
+            }
+        }
+        std::ranges::shuffle(lattice, rng);
+        std::string dense_data;
+        for (int y = 0; y < map_size; ++y) {
+            dense_data.append(map_size, '.');
+            dense_data.push_back('\n');
+        }
+        for (int i = 0; i < n_antennas; ++i) {
+            dense_data[lattice[i].y * (map_size + 1) + lattice[i].x] = 'a';
+        }
+        const Map dense_map = Map::parse(dense_data);
+        if (const int64_t count = dense_map.antinodes_count(), per_pair_count = dense_map.antinodes_count_per_pair();
+            count != per_pair_count) {
+            std::fprintf(
+                stderr,
+                "Dense map: %lld antinodes with normalized lines, %lld with a line per pair\n",
+                count,
+                per_pair_count);
+            return 1;
+        }
+        const auto time_count = [](const auto& count) {
+            constexpr int n_dense_runs = 3;
+            auto start = std::chrono::high_resolution_clock::now();
+            for (int n_run = 0; n_run < n_dense_runs; ++n_run) {
+                // ReSharper disable once CppDFAUnusedValue
+                // ReSharper disable once CppDFAUnreadVariable
+                // ReSharper disable once CppDeclaratorNeverUsed
+                volatile int64_t result = count();
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            return static_cast<int>(
+                std::round(std::chrono::duration<double, std::nano>(end - start).count() / n_dense_runs));
+        };
+        std::printf(
+            "Average ns (%d antenna dense map, normalized lines): %d\n",
+            n_antennas,
+            time_count([&] { return dense_map.antinodes_count(); }));
+        std::printf(
+            "Average ns (%d antenna dense map, line per pair): %d\n",
+            n_antennas,
+            time_count([&] { return dense_map.antinodes_count_per_pair(); }));
+    }
 #else
     std::printf("%lld\n", solve(data));
 #endif
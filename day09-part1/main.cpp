@@ -1,10 +1,12 @@
+#include <algorithm>
 #include <chrono>
 #include <cmath>
+#include <cstdint>
 #include <filesystem>
 #include <fstream>
-#include <ranges>
 #include <sstream>
-#include <vector>
+#include <string>
+#include <string_view>
 
 static std::string read_data(const std::filesystem::path& path)
 {
@@ -14,94 +16,63 @@ static std::string read_data(const std::filesystem::path& path)
     return ss.str();
 }
 
-struct Segment {
-    std::optional<int64_t> id;
-    int64_t size {};
-};
-
-static std::vector<Segment> parse_segments(const std::string& data)
+// Checksum contribution of a run of blocks of one file starting at pos, as an arithmetic series
+static int64_t run_checksum(const int64_t id, const int64_t pos, const int64_t size)
 {
-    std::vector<Segment> segments;
-    bool free = false;
-    int64_t id_count = 0;
-    for (int64_t i = 0; data[i] != '\n'; ++i) {
-        if (const int64_t num = data[i] - '0'; free && num > 0) {
-            segments.push_back({ .id = std::nullopt, .size = num });
-        }
-        else if (!free) {
-            segments.push_back({ .id = id_count++, .size = num });
-        }
-        free = !free;
-    }
-    return segments;
+    return id * (size * pos + size * (size - 1) / 2);
 }
 
-static void trim_free_end(std::vector<Segment>& segments)
+// Compacts with one cursor walking the disk map forwards and one walking file blocks backwards, summing the checksum
+// run by run as blocks are placed so nothing about the compacted disk is ever stored
+static int64_t compacted_checksum(const std::string_view disk_map)
 {
-    if (auto [id, size] = segments[segments.size() - 1]; !id.has_value()) {
-        segments.pop_back();
+    if (disk_map.empty()) {
+        return 0;
     }
-}
-
-static std::vector<Segment> defrag_segments(std::vector<Segment>&& segments)
-{
-    std::vector<Segment> defragged_segments;
-    trim_free_end(segments);
-    for (int64_t i = 0; i < segments.size(); ++i) {
-        Segment& segment = segments[i];
-        if (segment.id.has_value()) {
-            defragged_segments.push_back(segment);
-            continue;
+    const auto digit = [&](const int64_t i) -> int64_t { return disk_map[i] - '0'; };
+    int64_t right = static_cast<int64_t>(disk_map.size()) - 1;
+    if (right % 2 == 1) {
+        --right; // Trailing free space
+    }
+    int64_t right_remaining = digit(right);
+    int64_t left = 0;
+    int64_t pos = 0;
+    int64_t sum = 0;
+    while (left < right) {
+        if (left % 2 == 0) {
+            const int64_t size = digit(left);
+            sum += run_checksum(left / 2, pos, size);
+            pos += size;
         }
-        int64_t free_size = segment.size;
-        while (free_size > 0) {
-            trim_free_end(segments);
-            if (Segment& last_file = segments[segments.size() - 1]; last_file.size <= free_size) {
-                const int64_t last_size = last_file.size;
-                defragged_segments.push_back(last_file);
-                free_size -= last_size;
-                segments.pop_back();
-                if (i == segments.size() - 1) {
-                    break;
+        else {
+            int64_t free_size = digit(left);
+            while (free_size > 0 && right > left) {
+                const int64_t moved = std::min(free_size, right_remaining);
+                sum += run_checksum(right / 2, pos, moved);
+                pos += moved;
+                free_size -= moved;
+                right_remaining -= moved;
+                if (right_remaining == 0) {
+                    right -= 2;
+                    right_remaining = right >= 0 ? digit(right) : 0;
                 }
             }
-            else {
-                defragged_segments.push_back({ .id = last_file.id, .size = free_size });
-                last_file.size -= free_size;
-                free_size = 0;
-            }
         }
+        ++left;
     }
-    if (defragged_segments.size() >= 2) {
-        const auto& [last_id, last_size] = defragged_segments[defragged_segments.size() - 1];
-        if (auto& [second_last_id, second_last_size] = defragged_segments[defragged_segments.size() - 2];
-            last_id == second_last_id) {
-            second_last_size += last_size;
-            defragged_segments.pop_back();
-        }
-    }
-    return defragged_segments;
-}
-
-static int64_t checksum(const std::vector<Segment>& segments)
-{
-    int64_t sum = 0;
-    int64_t count = 0;
-    for (int64_t i = 0; i < segments.size() && segments[i].id.has_value(); ++i) {
-        const auto& [id, size] = segments[i];
-        for (int64_t j = 0; j < size; ++j) {
-            sum += count * id.value();
-            ++count;
-        }
+    if (left == right) {
+        sum += run_checksum(right / 2, pos, right_remaining);
     }
     return sum;
 }
 
 static int64_t solve(const std::string& data)
 {
-    std::vector<Segment> segments = parse_segments(data);
-    const std::vector<Segment> defragged_segments = defrag_segments(std::move(segments));
-    return checksum(defragged_segments);
+    std::string_view disk_map = data;
+    if (const size_t end = disk_map.find('\n'); end != std::string_view::npos) {
+        disk_map = disk_map.substr(0, end);
+    }
+    return compacted_checksum(disk_map);
 }
 
 int main()
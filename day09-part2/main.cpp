@@ -1,9 +1,15 @@
+#include <array>
 #include <chrono>
 #include <cmath>
+#include <cstdint>
 #include <filesystem>
 #include <fstream>
-#include <ranges>
+#include <functional>
+#include <optional>
+#include <queue>
+#include <random>
 #include <sstream>
+#include <string>
 #include <vector>
 
 static std::string read_data(const std::filesystem::path& path)
@@ -14,70 +20,124 @@ static std::string read_data(const std::filesystem::path& path)
     return ss.str();
 }
 
-struct Segment {
-    std::optional<int64_t> id;
-    int64_t size {};
+// Disk map segments as a struct of arrays, a segment's file id, size and start sit at the same index. Sizes are single
+// digits and the disk is assumed to hold fewer than 2^32 blocks
+struct Segments {
+    static constexpr uint32_t free_id = UINT32_MAX;
+
+    std::vector<uint32_t> ids;
+    std::vector<uint8_t> sizes;
+    std::vector<uint32_t> starts;
+
+    void push_back(const uint32_t id, const uint8_t size, const uint32_t start)
+    {
+        ids.push_back(id);
+        sizes.push_back(size);
+        starts.push_back(start);
+    }
+
+    [[nodiscard]] size_t size() const
+    {
+        return ids.size();
+    }
 };
 
-static std::vector<Segment> parse_segments(const std::string& data)
+constexpr size_t segment_bytes = sizeof(uint32_t) + sizeof(uint8_t) + sizeof(uint32_t);
+
+static Segments parse_segments(const std::string& data)
 {
-    std::vector<Segment> segments;
+    Segments segments;
+    const size_t length = data.find('\n');
+    segments.ids.reserve(length);
+    segments.sizes.reserve(length);
+    segments.starts.reserve(length);
     bool free = false;
-    int64_t id_count = 0;
-    for (int64_t i = 0; data[i] != '\n'; ++i) {
-        if (const int64_t num = data[i] - '0'; free && num > 0) {
-            segments.push_back({ .id = std::nullopt, .size = num });
+    uint32_t id_count = 0;
+    uint32_t pos = 0;
+    for (size_t i = 0; i < length; ++i) {
+        if (const auto num = static_cast<uint8_t>(data[i] - '0'); free && num > 0) {
+            segments.push_back(Segments::free_id, num, pos);
         }
         else if (!free) {
-            segments.push_back({ .id = id_count++, .size = num });
+            segments.push_back(id_count++, num, pos);
         }
+        pos += data[i] - '0';
         free = !free;
     }
     return segments;
 }
 
-static void defrag_segments(std::vector<Segment>& segments)
-{
-    for (int64_t i = static_cast<int64_t>(segments.size()) - 1; i >= 0; --i) {
-        auto& [id, size] = segments[i];
-        if (!id.has_value()) {
-            continue;
-        }
-        bool moved = false;
-        for (int64_t j = 0; j < i; ++j) {
-            auto& [defragged_id, defragged_size] = segments[j];
-            if (defragged_id.has_value()) {
-                continue;
-            }
-            if (defragged_size == size) {
-                defragged_id = id;
-                moved = true;
-                break;
+// Free spans bucketed by size into min-heaps of start positions, so the leftmost span of at least a given size is the
+// smallest of at most nine heap tops
+class FreeSpanIndex {
+public:
+    explicit FreeSpanIndex(const Segments& segments)
+    {
+        std::array<std::vector<uint32_t>, max_span_size + 1> starts;
+        for (size_t i = 0; i < segments.size(); ++i) {
+            if (segments.ids[i] == Segments::free_id) {
+                starts[segments.sizes[i]].push_back(segments.starts[i]);
             }
-            if (defragged_size > size) {
-                defragged_size -= size;
-                segments.insert(segments.begin() + j, { .id = id, .size = size });
-                moved = true;
-                ++i;
-                break;
+        }
+        // Spans come in increasing order, so each bucket is already a valid min-heap
+        for (int size = 1; size <= max_span_size; ++size) {
+            m_heaps[size] = MinHeap { std::greater<>(), std::move(starts[size]) };
+        }
+    }
+
+    // Takes the leftmost span of at least size blocks that starts before limit, returning its start. Whatever is left
+    // of the span goes back in the bucket for its new size
+    std::optional<uint32_t> take_leftmost(const int size, const uint32_t limit)
+    {
+        int best_size = 0;
+        uint32_t best_start = limit;
+        for (int span_size = size; span_size <= max_span_size; ++span_size) {
+            if (!m_heaps[span_size].empty() && m_heaps[span_size].top() < best_start) {
+                best_size = span_size;
+                best_start = m_heaps[span_size].top();
             }
         }
-        if (moved) {
-            segments[i].id.reset();
+        if (best_size == 0) {
+            return std::nullopt;
+        }
+        m_heaps[best_size].pop();
+        if (best_size > size) {
+            m_heaps[best_size - size].push(best_start + size);
+        }
+        return best_start;
+    }
+
+private:
+    static constexpr int max_span_size = 9;
+    using MinHeap = std::priority_queue<uint32_t, std::vector<uint32_t>, std::greater<>>;
+
+    std::array<MinHeap, max_span_size + 1> m_heaps;
+};
+
+// Moves each file once, from the highest id down, into the leftmost span that fits. The space a file leaves is never
+// reused since every file still to move starts further left
+static void compact_files(Segments& segments)
+{
+    FreeSpanIndex free_spans { segments };
+    for (size_t i = segments.size(); i-- > 0;) {
+        if (segments.ids[i] == Segments::free_id || segments.sizes[i] == 0) {
+            continue;
+        }
+        if (const std::optional<uint32_t> new_start = free_spans.take_leftmost(segments.sizes[i], segments.starts[i]);
+            new_start.has_value()) {
+            segments.starts[i] = new_start.value();
         }
     }
 }
 
-static int64_t checksum(const std::vector<Segment>& segments)
+static int64_t checksum(const Segments& segments)
 {
     int64_t sum = 0;
-    int64_t count = 0;
-    for (const auto& [id, size] : segments) {
-        for (int64_t j = 0; j < size; ++j) {
-            if (id.has_value()) {
-                sum += count * id.value();
-            }
-            ++count;
+    for (size_t i = 0; i < segments.size(); ++i) {
+        if (const uint32_t id = segments.ids[i]; id != Segments::free_id) {
+            const int64_t start = segments.starts[i];
+            const int64_t size = segments.sizes[i];
+            sum += id * (size * start + size * (size - 1) / 2);
         }
     }
     return sum;
@@ -85,8 +145,8 @@ static int64_t checksum(const std::vector<Segment>& segments)
 
 static int64_t solve(const std::string& data)
 {
-    std::vector<Segment> segments = parse_segments(data);
-    defrag_segments(segments);
+    Segments segments = parse_segments(data);
+    compact_files(segments);
     return checksum(segments);
 }
 
@@ -108,6 +168,39 @@ int main()
         time_running_total += std::chrono::duration<double, std::nano>(end - start).count();
     }
     std::printf("Average ns: %d\n", static_cast<int>(std::round(time_running_total / n_runs)));
+
+    // Synthetic disk map with a million files
+    {
+        constexpr int n_files = 1000000;
+        constexpr int n_synthetic_runs = 10;
+        std::mt19937 rng { 2024 };
+        std::uniform_int_distribution<int> file_size_dist { 1, 9 };
+        std::uniform_int_distribution<int> free_size_dist { 0, 9 };
+        std::string synthetic_data;
+        synthetic_data.reserve(n_files * 2);
+        for (int i = 0; i < n_files; ++i) {
+            synthetic_data.push_back(static_cast<char>('0' + file_size_dist(rng)));
+            if (i != n_files - 1) {
+                synthetic_data.push_back(static_cast<char>('0' + free_size_dist(rng)));
+            }
+        }
+        synthetic_data.push_back('\n');
+        double time_synthetic_total = 0.0;
+        for (int n_run = 0; n_run < n_synthetic_runs; ++n_run) {
+            auto start = std::chrono::high_resolution_clock::now();
+            // ReSharper disable once CppDFAUnusedValue
+            // ReSharper disable once CppDFAUnreadVariable
+            // ReSharper disable once CppDeclaratorNeverUsed
+            volatile int64_t result = solve(synthetic_data);
+            auto end = std::chrono::high_resolution_clock::now();
+            time_synthetic_total += std::chrono::duration<double, std::nano>(end - start).count();
+        }
+        std::printf(
+            "Average ns (%d file synthetic disk map): %d\n",
+            n_files,
+            static_cast<int>(std::round(time_synthetic_total / n_synthetic_runs)));
+        std::printf("Bytes per segment: %zu\n", segment_bytes);
+    }
 #else
     std::printf("%lld\n", solve(data));
 #endif
@@ -1,12 +1,20 @@
+#include <array>
+#include <bit>
 #include <chrono>
 #include <cmath>
+#include <cstdint>
 #include <filesystem>
 #include <fstream>
 #include <ranges>
 #include <sstream>
-#include <unordered_set>
+#include <string>
+#include <utility>
 #include <vector>
 
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
 static std::string read_data(const std::filesystem::path& path)
 {
     const std::fstream file { path };
@@ -15,148 +23,199 @@ static std::string read_data(const std::filesystem::path& path)
     return ss.str();
 }
 
-struct Vector2i {
-    int x;
-    int y;
-
-    Vector2i& operator+=(const Vector2i& other)
-    {
-        x += other.x;
-        y += other.y;
-        return *this;
-    }
-
-    Vector2i operator+(const Vector2i& other) const
-    {
-        return { x + other.x, y + other.y };
-    }
+// Heights are stored with a one cell border of padding, so every map cell has four neighbors in the grid. The padding
+// is never one above a real height
+constexpr uint8_t padding_height = 0xff;
 
-    Vector2i& operator-=(const Vector2i& other)
-    {
-        x -= other.x;
-        y -= other.y;
-        return *this;
-    }
+// Bits 0 to 3 are set when the neighbor to the left, right, above or below is exactly one higher
+static uint8_t uphill_mask(const uint8_t* height, const int stride)
+{
+    const uint8_t uphill = *height + 1;
+    return (height[-1] == uphill ? 1 : 0) | (height[1] == uphill ? 2 : 0) | (height[-stride] == uphill ? 4 : 0)
+        | (height[stride] == uphill ? 8 : 0);
+}
 
-    Vector2i operator-(const Vector2i& other) const
-    {
-        return { x - other.x, y - other.y };
-    }
+#if defined(__AVX2__)
+constexpr int uphill_lanes = 32;
 
-    bool operator==(const Vector2i& other) const
-    {
-        return x == other.x && y == other.y;
-    }
-
-    bool operator!=(const Vector2i& other) const
-    {
-        return x != other.x || y != other.y;
-    }
+// Writes uphill_mask for the uphill_lanes cells starting at height
+static void store_uphill_masks(const uint8_t* height, const int stride, uint8_t* masks)
+{
+    const auto load = [](const uint8_t* ptr) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr)); };
+    const __m256i uphill = _mm256_add_epi8(load(height), _mm256_set1_epi8(1));
+    const auto bit_if_uphill = [&](const uint8_t* neighbor, const char bit) {
+        return _mm256_and_si256(_mm256_cmpeq_epi8(load(neighbor), uphill), _mm256_set1_epi8(bit));
+    };
+    const __m256i result = _mm256_or_si256(
+        _mm256_or_si256(bit_if_uphill(height - 1, 1), bit_if_uphill(height + 1, 2)),
+        _mm256_or_si256(bit_if_uphill(height - stride, 4), bit_if_uphill(height + stride, 8)));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(masks), result);
+}
+#elif defined(__SSE2__) || defined(_M_X64)
+constexpr int uphill_lanes = 16;
 
-    bool operator<(const Vector2i& other) const
-    {
-        if (x == other.x) {
-            return y < other.y;
-        }
-        return x < other.x;
-    }
-};
+// Writes uphill_mask for the uphill_lanes cells starting at height
+static void store_uphill_masks(const uint8_t* height, const int stride, uint8_t* masks)
+{
+    const auto load = [](const uint8_t* ptr) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr)); };
+    const __m128i uphill = _mm_add_epi8(load(height), _mm_set1_epi8(1));
+    const auto bit_if_uphill = [&](const uint8_t* neighbor, const char bit) {
+        return _mm_and_si128(_mm_cmpeq_epi8(load(neighbor), uphill), _mm_set1_epi8(bit));
+    };
+    const __m128i result = _mm_or_si128(
+        _mm_or_si128(bit_if_uphill(height - 1, 1), bit_if_uphill(height + 1, 2)),
+        _mm_or_si128(bit_if_uphill(height - stride, 4), bit_if_uphill(height + stride, 8)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(masks), result);
+}
+#else
+constexpr int uphill_lanes = 1;
 
-template <>
-struct std::hash<Vector2i> {
-    size_t operator()(const Vector2i& vector) const noexcept
-    {
-        const size_t hash1 = std::hash<int>()(vector.x);
-        const size_t hash2 = std::hash<int>()(vector.y);
-        return hash1 ^ hash2 << 1;
-    }
-};
+static void store_uphill_masks(const uint8_t* height, const int stride, uint8_t* masks)
+{
+    *masks = uphill_mask(height, stride);
+}
+#endif
 
 class Map {
 public:
+    static constexpr int max_height = 9;
+
     static Map parse(const std::string& data)
     {
-        std::vector<int> heights;
-        std::vector<Vector2i> trailheads;
-        std::optional<int> width;
-        int y = 0;
-        for (int i = 0; i < data.size(); ++i) {
-            if (data[i] == '\n') {
-                if (!width.has_value()) {
-                    width = i;
+        const int width = static_cast<int>(data.find('\n'));
+        const int height = static_cast<int>(data.size()) / (width + 1);
+        const int stride = width + 2;
+        std::vector<uint8_t> heights(static_cast<size_t>(stride) * (height + 2), padding_height);
+        std::array<std::vector<int>, max_height + 1> levels;
+        std::vector<int> level_indices(heights.size(), 0);
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                const char c = data[y * (width + 1) + x];
+                if (c < '0' || c > '9') {
+                    continue; // Impassable, so it keeps the padding height and stays out of every level
                 }
-                ++y;
-                continue;
-            }
-            const int height = data[i] - '0';
-            heights.push_back(height);
-            if (height == 0) {
-                const int x = width.has_value() ? i % (width.value() + 1) : i;
-                trailheads.push_back({ x, y });
+                const int cell_height = c - '0';
+                const int i = (y + 1) * stride + x + 1;
+                heights[i] = static_cast<uint8_t>(cell_height);
+                level_indices[i] = static_cast<int>(levels[cell_height].size());
+                levels[cell_height].push_back(i);
             }
         }
-        return { std::move(heights), std::move(trailheads), { width.value(), y } };
+        return { std::move(heights), std::move(levels), std::move(level_indices), stride };
     }
 
+    // Works down from the peaks one height at a time, each cell's set of reachable peaks being the union of its uphill
+    // neighbors' sets. Only two heights are held at once
     [[nodiscard]] int64_t trailhead_scores_sum() const
     {
-        std::unordered_set<Vector2i> max_heights;
-        int64_t score_sum = 0;
-        for (const Vector2i& trailhead : m_trailheads) {
-            max_heights.clear();
-            reachable_max_heights_from(trailhead, max_heights);
-            score_sum += static_cast<int64_t>(max_heights.size());
-        }
-        return score_sum;
+        return m_levels[max_height].size() <= max_dense_peaks ? dense_scores_sum() : sparse_scores_sum();
     }
 
 private:
-    Map(std::vector<int>&& data, std::vector<Vector2i>&& trailheads, const Vector2i& size)
-        : m_data { std::move(data) }
-        , m_trailheads { std::move(trailheads) }
-        , m_size { size }
-    {
-    }
+    // Above this many peaks, bitsets over all of them cost more than lists of the few each cell can reach
+    static constexpr size_t max_dense_peaks = 256;
 
-    [[nodiscard]] bool in_bounds(const Vector2i& pos) const
+    Map(std::vector<uint8_t>&& heights,
+        std::array<std::vector<int>, max_height + 1>&& levels,
+        std::vector<int>&& level_indices,
+        const int stride)
+        : m_heights { std::move(heights) }
+        , m_levels { std::move(levels) }
+        , m_level_indices { std::move(level_indices) }
+        , m_uphill(m_heights.size(), 0)
+        , m_neighbor_offsets { -1, 1, -stride, stride }
     {
-        return pos.x >= 0 && pos.x < m_size.x && pos.y >= 0 && pos.y < m_size.y;
+        // Every row but the padding ones at the top and bottom, the padding columns get masks that are never read
+        const int end = static_cast<int>(m_heights.size()) - stride;
+        int i = stride;
+        for (; i + uphill_lanes <= end; i += uphill_lanes) {
+            store_uphill_masks(m_heights.data() + i, stride, m_uphill.data() + i);
+        }
+        for (; i < end; ++i) {
+            m_uphill[i] = uphill_mask(m_heights.data() + i, stride);
+        }
     }
 
-    [[nodiscard]] int index(const Vector2i& pos) const
+    // Peak sets as bitsets over all peaks, level size times peaks / 64 words per height
+    [[nodiscard]] int64_t dense_scores_sum() const
     {
-        return pos.y * m_size.x + pos.x;
+        const std::vector<int>& peaks = m_levels[max_height];
+        const int words = (static_cast<int>(peaks.size()) + 63) / 64;
+        std::vector<uint64_t> upper(peaks.size() * words, 0);
+        for (int i = 0; i < peaks.size(); ++i) {
+            upper[i * words + i / 64] |= uint64_t { 1 } << (i % 64);
+        }
+        std::vector<uint64_t> lower;
+        for (int height = max_height - 1; height >= 0; --height) {
+            const std::vector<int>& level = m_levels[height];
+            lower.assign(level.size() * words, 0);
+            for (int i = 0; i < level.size(); ++i) {
+                for_each_uphill_neighbor(level[i], [&](const int neighbor) {
+                    const uint64_t* from = upper.data() + m_level_indices[neighbor] * words;
+                    uint64_t* to = lower.data() + i * words;
+                    for (int word = 0; word < words; ++word) {
+                        to[word] |= from[word];
+                    }
+                });
+            }
+            std::swap(upper, lower);
+        }
+        int64_t score_sum = 0;
+        for (const uint64_t word : upper) {
+            score_sum += std::popcount(word);
+        }
+        return score_sum;
     }
 
-    [[nodiscard]] std::optional<int> height_at_opt(const Vector2i& pos) const
+    // Peak sets as unsorted lists of peak ids, cell i of a level owning ids[offsets[i]] to ids[offsets[i + 1]]. A cell
+    // only reaches peaks within max_height steps, so the lists stay short and a height takes time linear in its cells.
+    // Duplicates are dropped by stamping each peak with the last cell that took it
+    [[nodiscard]] int64_t sparse_scores_sum() const
     {
-        if (!in_bounds(pos)) {
-            return std::nullopt;
+        const std::vector<int>& peaks = m_levels[max_height];
+        std::vector<int> upper_offsets(peaks.size() + 1);
+        std::vector<int> upper_ids(peaks.size());
+        for (int i = 0; i < peaks.size(); ++i) {
+            upper_offsets[i + 1] = i + 1;
+            upper_ids[i] = i;
+        }
+        std::vector<int> lower_offsets;
+        std::vector<int> lower_ids;
+        std::vector<int> stamps(peaks.size(), -1);
+        for (int height = max_height - 1; height >= 0; --height) {
+            lower_offsets.assign(1, 0);
+            lower_ids.clear();
+            for (const int cell : m_levels[height]) {
+                for_each_uphill_neighbor(cell, [&](const int neighbor) {
+                    const int j = m_level_indices[neighbor];
+                    for (int k = upper_offsets[j]; k < upper_offsets[j + 1]; ++k) {
+                        if (const int id = upper_ids[k]; stamps[id] != cell) {
+                            stamps[id] = cell;
+                            lower_ids.push_back(id);
+                        }
+                    }
+                });
+                lower_offsets.push_back(static_cast<int>(lower_ids.size()));
+            }
+            std::swap(upper_offsets, lower_offsets);
+            std::swap(upper_ids, lower_ids);
         }
-        return m_data[index(pos)];
+        return static_cast<int64_t>(upper_ids.size());
     }
 
-    void reachable_max_heights_from( // NOLINT(*-no-recursion)
-        const Vector2i& pos, std::unordered_set<Vector2i>& max_heights) const
+    template <typename Fn>
+    void for_each_uphill_neighbor(const int i, Fn&& fn) const
     {
-        const int current_height = m_data[index(pos)];
-        if (current_height == 9) {
-            max_heights.insert(pos);
-            return;
-        }
-        for (constexpr std::array<Vector2i, 4> offsets { { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } } };
-             const Vector2i& offset : offsets) {
-            const Vector2i neighbor_pos = pos + offset;
-            if (const std::optional<int> neighbor_height = height_at_opt(neighbor_pos);
-                neighbor_height.has_value() && neighbor_height.value() == current_height + 1) {
-                reachable_max_heights_from(neighbor_pos, max_heights);
-            }
+        for (uint8_t mask = m_uphill[i]; mask != 0; mask &= mask - 1) {
+            fn(i + m_neighbor_offsets[std::countr_zero(mask)]);
         }
     }
 
-    std::vector<int> m_data;
-    std::vector<Vector2i> m_trailheads;
-    Vector2i m_size;
+    std::vector<uint8_t> m_heights;
+    std::array<std::vector<int>, max_height + 1> m_levels; // Cell indices of each height
+    std::vector<int> m_level_indices; // Position of each cell within its height's level
+    std::vector<uint8_t> m_uphill;
+    std::array<int, 4> m_neighbor_offsets;
 };
 
 static int64_t solve(const std::string& data)
@@ -183,6 +242,36 @@ int main()
         time_running_total += std::chrono::duration<double, std::nano>(end - start).count();
     }
     std::printf("Average ns: %d\n", static_cast<int>(std::round(time_running_total / n_runs)));
+
+    // The input tiled into a map of about a million cells, with far too many peaks for bitsets over all of them
+    {
+        constexpr int n_tiles = 18;
+        const size_t width = data.find('\n');
+        std::string tiled_data;
+        for (int tile_y = 0; tile_y < n_tiles; ++tile_y) {
+            for (size_t row = 0; row + width < data.size(); row += width + 1) {
+                for (int tile_x = 0; tile_x < n_tiles; ++tile_x) {
+                    tiled_data.append(data, row, width);
+                }
+                tiled_data.push_back('\n');
+            }
+        }
+        const Map tiled_map = Map::parse(tiled_data);
+        constexpr int n_tiled_runs = 10;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int n_run = 0; n_run < n_tiled_runs; ++n_run) {
+            // ReSharper disable once CppDFAUnusedValue
+            // ReSharper disable once CppDFAUnreadVariable
+            // ReSharper disable once CppDeclaratorNeverUsed
+            volatile int64_t result = tiled_map.trailhead_scores_sum();
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        std::printf(
+            "Average ns (%dx%d tiled map): %d\n",
+            static_cast<int>(width) * n_tiles,
+            static_cast<int>(width) * n_tiles,
+            static_cast<int>(std::round(std::chrono::duration<double, std::nano>(end - start).count() / n_tiled_runs)));
+    }
 #else
     std::printf("%lld\n", solve(data));
 #endif
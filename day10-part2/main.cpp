@@ -1,12 +1,19 @@
+#include <array>
+#include <bit>
 #include <chrono>
 #include <cmath>
+#include <cstdint>
 #include <filesystem>
 #include <fstream>
 #include <ranges>
 #include <sstream>
-#include <unordered_set>
+#include <string>
 #include <vector>
 
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
 static std::string read_data(const std::filesystem::path& path)
 {
     const std::fstream file { path };
@@ -15,145 +22,138 @@ static std::string read_data(const std::filesystem::path& path)
     return ss.str();
 }
 
-struct Vector2i {
-    int x;
-    int y;
+// Heights are stored with a one cell border of padding, so every map cell has four neighbors in the grid. The padding
+// is never one above a real height
+constexpr uint8_t padding_height = 0xff;
 
-    Vector2i& operator+=(const Vector2i& other)
-    {
-        x += other.x;
-        y += other.y;
-        return *this;
-    }
-
-    Vector2i operator+(const Vector2i& other) const
-    {
-        return { x + other.x, y + other.y };
-    }
-
-    Vector2i& operator-=(const Vector2i& other)
-    {
-        x -= other.x;
-        y -= other.y;
-        return *this;
-    }
-
-    Vector2i operator-(const Vector2i& other) const
-    {
-        return { x - other.x, y - other.y };
-    }
+// Bits 0 to 3 are set when the neighbor to the left, right, above or below is exactly one higher
+static uint8_t uphill_mask(const uint8_t* height, const int stride)
+{
+    const uint8_t uphill = *height + 1;
+    return (height[-1] == uphill ? 1 : 0) | (height[1] == uphill ? 2 : 0) | (height[-stride] == uphill ? 4 : 0)
+        | (height[stride] == uphill ? 8 : 0);
+}
 
-    bool operator==(const Vector2i& other) const
-    {
-        return x == other.x && y == other.y;
-    }
+#if defined(__AVX2__)
+constexpr int uphill_lanes = 32;
 
-    bool operator!=(const Vector2i& other) const
-    {
-        return x != other.x || y != other.y;
-    }
+// Writes uphill_mask for the uphill_lanes cells starting at height
+static void store_uphill_masks(const uint8_t* height, const int stride, uint8_t* masks)
+{
+    const auto load = [](const uint8_t* ptr) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr)); };
+    const __m256i uphill = _mm256_add_epi8(load(height), _mm256_set1_epi8(1));
+    const auto bit_if_uphill = [&](const uint8_t* neighbor, const char bit) {
+        return _mm256_and_si256(_mm256_cmpeq_epi8(load(neighbor), uphill), _mm256_set1_epi8(bit));
+    };
+    const __m256i result = _mm256_or_si256(
+        _mm256_or_si256(bit_if_uphill(height - 1, 1), bit_if_uphill(height + 1, 2)),
+        _mm256_or_si256(bit_if_uphill(height - stride, 4), bit_if_uphill(height + stride, 8)));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(masks), result);
+}
+#elif defined(__SSE2__) || defined(_M_X64)
+constexpr int uphill_lanes = 16;
 
-    bool operator<(const Vector2i& other) const
-    {
-        if (x == other.x) {
-            return y < other.y;
-        }
-        return x < other.x;
-    }
-};
+// Writes uphill_mask for the uphill_lanes cells starting at height
+static void store_uphill_masks(const uint8_t* height, const int stride, uint8_t* masks)
+{
+    const auto load = [](const uint8_t* ptr) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr)); };
+    const __m128i uphill = _mm_add_epi8(load(height), _mm_set1_epi8(1));
+    const auto bit_if_uphill = [&](const uint8_t* neighbor, const char bit) {
+        return _mm_and_si128(_mm_cmpeq_epi8(load(neighbor), uphill), _mm_set1_epi8(bit));
+    };
+    const __m128i result = _mm_or_si128(
+        _mm_or_si128(bit_if_uphill(height - 1, 1), bit_if_uphill(height + 1, 2)),
+        _mm_or_si128(bit_if_uphill(height - stride, 4), bit_if_uphill(height + stride, 8)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(masks), result);
+}
+#else
+constexpr int uphill_lanes = 1;
 
-template <>
-struct std::hash<Vector2i> {
-    size_t operator()(const Vector2i& vector) const noexcept
-    {
-        const size_t hash1 = std::hash<int>()(vector.x);
-        const size_t hash2 = std::hash<int>()(vector.y);
-        return hash1 ^ hash2 << 1;
-    }
-};
+static void store_uphill_masks(const uint8_t* height, const int stride, uint8_t* masks)
+{
+    *masks = uphill_mask(height, stride);
+}
+#endif
 
 class Map {
 public:
+    static constexpr int max_height = 9;
+
     static Map parse(const std::string& data)
     {
-        std::vector<int> heights;
-        std::vector<Vector2i> trailheads;
-        std::optional<int> width;
-        int y = 0;
-        for (int i = 0; i < data.size(); ++i) {
-            if (data[i] == '\n') {
-                if (!width.has_value()) {
-                    width = i;
+        const int width = static_cast<int>(data.find('\n'));
+        const int height = static_cast<int>(data.size()) / (width + 1);
+        const int stride = width + 2;
+        std::vector<uint8_t> heights(static_cast<size_t>(stride) * (height + 2), padding_height);
+        std::array<std::vector<int>, max_height + 1> levels;
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                const char c = data[y * (width + 1) + x];
+                if (c < '0' || c > '9') {
+                    continue; // Impassable, so it keeps the padding height and stays out of every level
                 }
-                ++y;
-                continue;
-            }
-            const int height = data[i] - '0';
-            heights.push_back(height);
-            if (height == 0) {
-                const int x = width.has_value() ? i % (width.value() + 1) : i;
-                trailheads.push_back({ x, y });
+                const int cell_height = c - '0';
+                const int i = (y + 1) * stride + x + 1;
+                heights[i] = static_cast<uint8_t>(cell_height);
+                levels[cell_height].push_back(i);
             }
         }
-        return { std::move(heights), std::move(trailheads), { width.value(), y } };
+        return { std::move(heights), std::move(levels), stride };
     }
 
+    // Works down from the peaks one height at a time, each cell's rating being the sum of its uphill neighbors' ratings
     [[nodiscard]] int64_t trailhead_ratings_sum() const
     {
+        std::vector<int64_t> ratings(m_heights.size(), 0);
+        for (const int peak : m_levels[max_height]) {
+            ratings[peak] = 1;
+        }
+        for (int height = max_height - 1; height >= 0; --height) {
+            for (const int i : m_levels[height]) {
+                int64_t rating = 0;
+                for_each_uphill_neighbor(i, [&](const int neighbor) { rating += ratings[neighbor]; });
+                ratings[i] = rating;
+            }
+        }
         int64_t ratings_sum = 0;
-        for (const Vector2i& trailhead : m_trailheads) {
-            ratings_sum += rating_from(trailhead);
+        for (const int trailhead : m_levels[0]) {
+            ratings_sum += ratings[trailhead];
         }
         return ratings_sum;
     }
 
 private:
-    Map(std::vector<int>&& data, std::vector<Vector2i>&& trailheads, const Vector2i& size)
-        : m_data { std::move(data) }
-        , m_trailheads { std::move(trailheads) }
-        , m_size { size }
+    Map(std::vector<uint8_t>&& heights,
+        std::array<std::vector<int>, max_height + 1>&& levels,
+        const int stride)
+        : m_heights { std::move(heights) }
+        , m_levels { std::move(levels) }
+        , m_uphill(m_heights.size(), 0)
+        , m_neighbor_offsets { -1, 1, -stride, stride }
     {
-    }
-
-    [[nodiscard]] bool in_bounds(const Vector2i& pos) const
-    {
-        return pos.x >= 0 && pos.x < m_size.x && pos.y >= 0 && pos.y < m_size.y;
-    }
-
-    [[nodiscard]] int index(const Vector2i& pos) const
-    {
-        return pos.y * m_size.x + pos.x;
-    }
-
-    [[nodiscard]] std::optional<int> height_at_opt(const Vector2i& pos) const
-    {
-        if (!in_bounds(pos)) {
-            return std::nullopt;
+        // Every row but the padding ones at the top and bottom, the padding columns get masks that are never read
+        const int end = static_cast<int>(m_heights.size()) - stride;
+        int i = stride;
+        for (; i + uphill_lanes <= end; i += uphill_lanes) {
+            store_uphill_masks(m_heights.data() + i, stride, m_uphill.data() + i);
+        }
+        for (; i < end; ++i) {
+            m_uphill[i] = uphill_mask(m_heights.data() + i, stride);
         }
-        return m_data[index(pos)];
     }
 
-    [[nodiscard]] int64_t rating_from(const Vector2i& pos) const // NOLINT(*-no-recursion)
+    template <typename Fn>
+    void for_each_uphill_neighbor(const int i, Fn&& fn) const
     {
-        const int current_height = m_data[index(pos)];
-        if (current_height == 9) {
-            return 1;
-        }
-        int64_t rating = 0;
-        for (constexpr std::array<Vector2i, 4> offsets { { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } } };
-             const Vector2i& offset : offsets) {
-            const Vector2i neighbor_pos = pos + offset;
-            if (const std::optional<int> neighbor_height = height_at_opt(neighbor_pos);
-                neighbor_height.has_value() && neighbor_height.value() == current_height + 1) {
-                rating += rating_from(neighbor_pos);
-            }
+        for (uint8_t mask = m_uphill[i]; mask != 0; mask &= mask - 1) {
+            fn(i + m_neighbor_offsets[std::countr_zero(mask)]);
         }
-        return rating;
     }
 
-    std::vector<int> m_data;
-    std::vector<Vector2i> m_trailheads;
-    Vector2i m_size;
+    std::vector<uint8_t> m_heights;
+    std::array<std::vector<int>, max_height + 1> m_levels; // Cell indices of each height
+    std::vector<uint8_t> m_uphill;
+    std::array<int, 4> m_neighbor_offsets;
 };
 
 static int64_t solve(const std::string& data)
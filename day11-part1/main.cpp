@@ -1,10 +1,14 @@
+#include <algorithm>
+#include <array>
+#include <bit>
 #include <chrono>
 #include <cmath>
+#include <cstdint>
 #include <filesystem>
 #include <fstream>
-#include <ranges>
 #include <sstream>
-#include <unordered_map>
+#include <string>
+#include <utility>
 #include <vector>
 
 static std::string read_data(const std::filesystem::path& path)
@@ -30,18 +34,106 @@ static uint64_t parse_int(const std::string& string, int& pos)
     return result;
 }
 
-static std::unordered_map<uint64_t, uint64_t> parse_stones(const std::string& data)
+// Stone to count map with open addressing, linear probing and a multiplicative hash. Clearing keeps the slots, so the
+// two tables that blinking alternates between only allocate while they are still growing
+class StoneCounts {
+public:
+    // Makes room for size stones, keeping the table at most half full
+    void reserve(const size_t size)
+    {
+        size_t capacity = std::max(m_keys.size(), min_capacity);
+        while (capacity < size * 2) {
+            capacity *= 2;
+        }
+        if (capacity != m_keys.size()) {
+            rehash(capacity);
+        }
+    }
+
+    void add(const uint64_t stone, const uint64_t count)
+    {
+        if ((m_size + 1) * 2 > m_keys.size()) {
+            reserve(m_size + 1);
+        }
+        size_t slot = slot_of(stone);
+        while (m_keys[slot] != stone) {
+            if (m_keys[slot] == empty_key) {
+                m_keys[slot] = stone;
+                m_counts[slot] = 0;
+                ++m_size;
+                break;
+            }
+            slot = (slot + 1) & (m_keys.size() - 1);
+        }
+        m_counts[slot] += count;
+    }
+
+    void clear()
+    {
+        std::ranges::fill(m_keys, empty_key);
+        m_size = 0;
+    }
+
+    [[nodiscard]] size_t size() const
+    {
+        return m_size;
+    }
+
+    template <typename Fn>
+    void for_each(Fn&& fn) const
+    {
+        for (size_t slot = 0; slot < m_keys.size(); ++slot) {
+            if (m_keys[slot] != empty_key) {
+                fn(m_keys[slot], m_counts[slot]);
+            }
+        }
+    }
+
+    [[nodiscard]] uint64_t total() const
+    {
+        uint64_t total = 0;
+        for_each([&](uint64_t, const uint64_t count) { total += count; });
+        return total;
+    }
+
+private:
+    // Never a stone, it would take a 20 digit stone with an odd digit count
+    static constexpr uint64_t empty_key = UINT64_MAX;
+    static constexpr size_t min_capacity = 16;
+
+    [[nodiscard]] size_t slot_of(const uint64_t stone) const
+    {
+        return (stone * 0x9e3779b97f4a7c15) >> m_shift;
+    }
+
+    void rehash(const size_t capacity)
+    {
+        std::vector<uint64_t> keys(capacity, empty_key);
+        std::vector<uint64_t> counts(capacity, 0);
+        std::swap(keys, m_keys);
+        std::swap(counts, m_counts);
+        m_shift = std::countl_zero(capacity) + 1;
+        m_size = 0;
+        for (size_t slot = 0; slot < keys.size(); ++slot) {
+            if (keys[slot] != empty_key) {
+                add(keys[slot], counts[slot]);
+            }
+        }
+    }
+
+    std::vector<uint64_t> m_keys;
+    std::vector<uint64_t> m_counts;
+    size_t m_size = 0;
+    int m_shift = 64;
+};
+
+static StoneCounts parse_stones(const std::string& data)
 {
-    std::unordered_map<uint64_t, uint64_t> stones;
+    StoneCounts stones;
     int pos = 0;
     while (true) {
         const uint64_t stone = parse_int(data, pos);
-        if (auto it = stones.find(stone); it != stones.end()) {
-            ++it->second;
-        }
-        else {
-            stones[stone] = 1;
-        }
+        stones.add(stone, 1);
         if (data[pos] == '\n') {
             break;
         }
@@ -86,47 +178,37 @@ static int digits_count(const uint64_t num)
     return count;
 }
 
-static void blink(std::unordered_map<uint64_t, uint64_t>& stones)
+// Each stone becomes at most two, so the next generation is sized from the distinct stones of this one
+static void blink(StoneCounts& stones, StoneCounts& new_stones)
 {
-    static std::unordered_map<uint64_t, uint64_t> new_stones;
     new_stones.clear();
-    auto add_stone = [](const uint64_t stone, const uint64_t count) {
-        if (const auto it = new_stones.find(stone); it != new_stones.end()) {
-            it->second += count;
-        }
-        else {
-            new_stones[stone] = count;
-        }
-    };
-    for (auto& [stone, count] : stones) {
+    new_stones.reserve(stones.size() * 2);
+    stones.for_each([&](const uint64_t stone, const uint64_t count) {
         if (stone == 0) {
-            add_stone(1, count);
+            new_stones.add(1, count);
         }
         else if (const int digits = digits_count(stone); digits % 2 == 0) {
             const uint64_t divisor = pow10[digits / 2];
             const uint64_t first = stone / divisor;
             const uint64_t second = stone % divisor;
-            add_stone(first, count);
-            add_stone(second, count);
+            new_stones.add(first, count);
+            new_stones.add(second, count);
         }
         else {
-            add_stone(stone * 2024, count);
+            new_stones.add(stone * 2024, count);
         }
-    }
+    });
     std::swap(stones, new_stones);
 }
 
 static uint64_t solve(const std::string& data)
 {
-    std::unordered_map<uint64_t, uint64_t> stones = parse_stones(data);
+    StoneCounts stones = parse_stones(data);
+    StoneCounts new_stones;
     for (int i = 0; i < 25; ++i) {
-        blink(stones);
-    }
-    uint64_t stone_count = 0;
-    for (const uint64_t count : stones | std::views::values) {
-        stone_count += count;
+        blink(stones, new_stones);
     }
-    return stone_count;
+    return stones.total();
 }
 
 int main()
@@ -1,10 +1,14 @@
+#include <algorithm>
+#include <array>
+#include <bit>
 #include <chrono>
 #include <cmath>
+#include <cstdint>
 #include <filesystem>
 #include <fstream>
-#include <ranges>
 #include <sstream>
-#include <unordered_map>
+#include <string>
+#include <utility>
 #include <vector>
 
 static std::string read_data(const std::filesystem::path& path)
@@ -30,27 +34,71 @@ static uint64_t parse_int(const std::string& string, int& pos)
     return result;
 }
 
-static std::unordered_map<uint64_t, uint64_t> parse_stones(const std::string& data)
-{
-    std::unordered_map<uint64_t, uint64_t> stones;
-    int pos = 0;
-    while (true) {
-        const uint64_t stone = parse_int(data, pos);
-        if (auto it = stones.find(stone); it != stones.end()) {
-            ++it->second;
+#ifdef __SIZEOF_INT128__
+using Count = unsigned __int128;
+#else
+using Count = uint64_t;
+#endif
+
+// Stone to id map with open addressing, linear probing and a multiplicative hash
+class StoneIds {
+public:
+    static constexpr uint32_t no_id = UINT32_MAX;
+
+    // Returns the id of stone, handing out the next free one when it is new
+    uint32_t intern(const uint64_t stone)
+    {
+        if ((m_size + 1) * 2 > m_keys.size()) {
+            rehash(std::max(m_keys.size() * 2, min_capacity));
         }
-        else {
-            stones[stone] = 1;
+        size_t slot = slot_of(stone);
+        while (m_keys[slot] != stone) {
+            if (m_keys[slot] == empty_key) {
+                m_keys[slot] = stone;
+                m_ids[slot] = m_size++;
+                break;
+            }
+            slot = (slot + 1) & (m_keys.size() - 1);
         }
-        if (data[pos] == '\n') {
-            break;
+        return m_ids[slot];
+    }
+
+private:
+    // Never a stone, it would take a 20 digit stone with an odd digit count
+    static constexpr uint64_t empty_key = UINT64_MAX;
+    static constexpr size_t min_capacity = 16;
+
+    [[nodiscard]] size_t slot_of(const uint64_t stone) const
+    {
+        return (stone * 0x9e3779b97f4a7c15) >> m_shift;
+    }
+
+    void rehash(const size_t capacity)
+    {
+        std::vector<uint64_t> keys(capacity, empty_key);
+        std::vector<uint32_t> ids(capacity, no_id);
+        std::swap(keys, m_keys);
+        std::swap(ids, m_ids);
+        m_shift = std::countl_zero(capacity) + 1;
+        for (size_t slot = 0; slot < keys.size(); ++slot) {
+            if (keys[slot] != empty_key) {
+                size_t new_slot = slot_of(keys[slot]);
+                while (m_keys[new_slot] != empty_key) {
+                    new_slot = (new_slot + 1) & (m_keys.size() - 1);
+                }
+                m_keys[new_slot] = keys[slot];
+                m_ids[new_slot] = ids[slot];
+            }
         }
-        ++pos; // " "
     }
-    return stones;
-}
 
-constexpr std::array pow10 {
+    std::vector<uint64_t> m_keys;
+    std::vector<uint32_t> m_ids;
+    uint32_t m_size = 0;
+    int m_shift = 64;
+};
+
+static constexpr std::array pow10 = {
     1ULL,
     10ULL,
     100ULL,
@@ -86,48 +134,129 @@ static int digits_count(const uint64_t num)
     return count;
 }
 
-static void blink(std::unordered_map<uint64_t, uint64_t>& stones)
-{
-    static std::unordered_map<uint64_t, uint64_t> new_stones;
-    new_stones.clear();
-    auto add_stone = [](const uint64_t stone, const uint64_t count) {
-        if (const auto it = new_stones.find(stone); it != new_stones.end()) {
-            it->second += count;
+// Stone counts of one arrangement after any number of blinks. The stones that show up form a small closed set, so each
+// distinct stone gets an id and its children are worked out the first time it blinks; a blink is then a pass over id
+// indexed counts. The total of every depth reached is kept, so a query only blinks on from the deepest one so far
+class Blinker {
+public:
+    static Blinker parse(const std::string& data)
+    {
+        Blinker blinker;
+        int pos = 0;
+        while (true) {
+            const uint32_t id = blinker.intern(parse_int(data, pos));
+            if (id == blinker.m_counts.size()) {
+                blinker.m_counts.push_back(0);
+            }
+            ++blinker.m_counts[id];
+            if (data[pos] == '\n') {
+                break;
+            }
+            ++pos;
         }
-        else {
-            new_stones[stone] = count;
+        blinker.m_totals.push_back(blinker.total());
+        return blinker;
+    }
+
+    [[nodiscard]] Count stone_count(const int blinks)
+    {
+        while (m_totals.size() <= static_cast<size_t>(blinks)) {
+            blink();
+            m_totals.push_back(total());
         }
-    };
-    for (auto& [stone, count] : stones) {
+        return m_totals[blinks];
+    }
+
+private:
+    Blinker() = default;
+
+    uint32_t intern(const uint64_t stone)
+    {
+        const uint32_t id = m_ids.intern(stone);
+        if (id == m_stones.size()) {
+            m_stones.push_back(stone);
+            m_children.push_back({ StoneIds::no_id, StoneIds::no_id });
+        }
+        return id;
+    }
+
+    void expand(const uint32_t id)
+    {
+        const uint64_t stone = m_stones[id];
+        std::array<uint32_t, 2> children { StoneIds::no_id, StoneIds::no_id };
         if (stone == 0) {
-            add_stone(1, count);
+            children[0] = intern(1);
         }
         else if (const int digits = digits_count(stone); digits % 2 == 0) {
             const uint64_t divisor = pow10[digits / 2];
-            const uint64_t first = stone / divisor;
-            const uint64_t second = stone % divisor;
-            add_stone(first, count);
-            add_stone(second, count);
+            children[0] = intern(stone / divisor);
+            children[1] = intern(stone % divisor);
         }
         else {
-            add_stone(stone * 2024, count);
+            children[0] = intern(stone * 2024);
+        }
+        m_children[id] = children;
+    }
+
+    void blink()
+    {
+        // Every stone has a first child, so a missing one marks a stone that has not blinked yet
+        for (uint32_t id = 0; id < m_counts.size(); ++id) {
+            if (m_counts[id] != 0 && m_children[id][0] == StoneIds::no_id) {
+                expand(id);
+            }
+        }
+        m_counts.resize(m_stones.size(), 0);
+        m_new_counts.assign(m_stones.size(), 0);
+        for (uint32_t id = 0; id < m_counts.size(); ++id) {
+            if (const Count count = m_counts[id]; count != 0) {
+                const auto [first, second] = m_children[id];
+                m_new_counts[first] += count;
+                if (second != StoneIds::no_id) {
+                    m_new_counts[second] += count;
+                }
+            }
+        }
+        std::swap(m_counts, m_new_counts);
+    }
+
+    [[nodiscard]] Count total() const
+    {
+        Count total = 0;
+        for (const Count count : m_counts) {
+            total += count;
         }
+        return total;
     }
-    std::swap(stones, new_stones);
+
+    StoneIds m_ids;
+    std::vector<uint64_t> m_stones;
+    std::vector<std::array<uint32_t, 2>> m_children;
+    std::vector<Count> m_counts;
+    std::vector<Count> m_new_counts;
+    std::vector<Count> m_totals;
+};
+
+static Count solve(const std::string& data)
+{
+    return Blinker::parse(data).stone_count(75);
 }
 
-static uint64_t solve(const std::string& data)
+#ifndef BENCHMARK
+static std::string to_string(Count value)
 {
-    std::unordered_map<uint64_t, uint64_t> stones = parse_stones(data);
-    for (int i = 0; i < 75; ++i) {
-        blink(stones);
+    if (value == 0) {
+        return "0";
     }
-    uint64_t stone_count = 0;
-    for (const uint64_t count : stones | std::views::values) {
-        stone_count += count;
+    std::string string;
+    while (value != 0) {
+        string.push_back(static_cast<char>('0' + static_cast<int>(value % 10)));
+        value /= 10;
     }
-    return stone_count;
+    std::ranges::reverse(string);
+    return string;
 }
+#endif
 
 int main()
 {
@@ -142,12 +271,37 @@ int main()
         // ReSharper disable once CppDFAUnusedValue
         // ReSharper disable once CppDFAUnreadVariable
         // ReSharper disable once CppDeclaratorNeverUsed
-        volatile uint64_t result = solve(data);
+        volatile Count result = solve(data);
         auto end = std::chrono::high_resolution_clock::now();
         time_running_total += std::chrono::duration<double, std::nano>(end - start).count();
     }
     std::printf("Average ns: %d\n", static_cast<int>(std::round(time_running_total / n_runs)));
+
+    // Counts at every depth up to one that still fits in 128 bits, sharing one blinker or starting over for each depth
+    constexpr int max_depth = 150;
+    const auto time_all_depths = [&](const bool shared) {
+        constexpr int n_depth_runs = 10;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int n_run = 0; n_run < n_depth_runs; ++n_run) {
+            Blinker blinker = Blinker::parse(data);
+            Count total = 0;
+            for (int depth = 1; depth <= max_depth; ++depth) {
+                if (!shared) {
+                    blinker = Blinker::parse(data);
+                }
+                total += blinker.stone_count(depth);
+            }
+            // ReSharper disable once CppDFAUnusedValue
+            // ReSharper disable once CppDFAUnreadVariable
+            // ReSharper disable once CppDeclaratorNeverUsed
+            volatile Count result = total;
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration<double, std::nano>(end - start).count() / n_depth_runs;
+    };
+    std::printf("Average ns (depths 1..%d, shared blinker): %.0f\n", max_depth, time_all_depths(true));
+    std::printf("Average ns (depths 1..%d, blinker per depth): %.0f\n", max_depth, time_all_depths(false));
 #else
-    std::printf("%llu\n", solve(data));
+    std::printf("%s\n", to_string(solve(data)).c_str());
 #endif
 }
\ No newline at end of file